@@ -0,0 +1,346 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/abort.h"
+#include "ns3/assert.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/enum.h"
+#include "ns3/boolean.h"
+#include "ns3/trace-source-accessor.h"
+#include <algorithm>
+#include <cstring>
+#include "async-pcap-writer.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("AsyncPcapWriter");
+
+NS_OBJECT_ENSURE_REGISTERED (AsyncPcapWriter);
+
+/// Size of the header of a pcap record
+static const uint32_t RECORD_HEADER_SIZE = 16;
+/// Wall clock time after which the writer thread writes a partial batch, in ns
+static const uint64_t WRITER_PERIOD = 10000000;
+/// Wall clock time between two checks of a full ring, in ns
+static const uint64_t BLOCK_PERIOD = 1000000;
+/// Data link type of 802.11 frames
+static const uint32_t DLT_IEEE802_11 = 105;
+/// Data link type of 802.11 frames with a radiotap header
+static const uint32_t DLT_IEEE802_11_RADIO = 127;
+
+TypeId
+AsyncPcapWriter::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::AsyncPcapWriter")
+    .SetParent<Object> ()
+    .SetGroupName ("Network")
+    .AddConstructor<AsyncPcapWriter> ()
+    .AddAttribute ("BufferSize",
+                   "The size of the ring of pending records, in bytes, rounded up to a power of two.",
+                   UintegerValue (4 << 20),
+                   MakeUintegerAccessor (&AsyncPcapWriter::m_bufferSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("BatchSize",
+                   "The number of pending bytes which wake up the writer thread.",
+                   UintegerValue (64 << 10),
+                   MakeUintegerAccessor (&AsyncPcapWriter::m_batchSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("Backpressure",
+                   "What to do with a record when the ring is full.",
+                   EnumValue (AsyncPcapWriter::BLOCK),
+                   MakeEnumAccessor (&AsyncPcapWriter::m_backpressure),
+                   MakeEnumChecker (AsyncPcapWriter::BLOCK, "Block",
+                                    AsyncPcapWriter::DROP, "Drop"))
+    .AddAttribute ("ManagementFrames",
+                   "Whether the 802.11 management frames are written.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&AsyncPcapWriter::m_managementFrames),
+                   MakeBooleanChecker ())
+    .AddAttribute ("ControlFrames",
+                   "Whether the 802.11 control frames are written.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&AsyncPcapWriter::m_controlFrames),
+                   MakeBooleanChecker ())
+    .AddAttribute ("DataFrames",
+                   "Whether the 802.11 data frames are written.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&AsyncPcapWriter::m_dataFrames),
+                   MakeBooleanChecker ())
+    .AddAttribute ("DataSampling",
+                   "Write one 802.11 data frame out of this many.",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&AsyncPcapWriter::m_dataSampling),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddTraceSource ("Drop",
+                     "A packet was not written because the ring was full.",
+                     MakeTraceSourceAccessor (&AsyncPcapWriter::m_dropTrace),
+                     "ns3::Packet::TracedCallback")
+  ;
+  return tid;
+}
+
+AsyncPcapWriter::AsyncPcapWriter ()
+  : m_snapLen (0),
+    m_dataLinkType (0),
+    m_nDataFrames (0),
+    m_mask (0),
+    m_head (0),
+    m_tail (0),
+    m_stopping (false),
+    m_written (0),
+    m_dropped (0),
+    m_filtered (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+AsyncPcapWriter::~AsyncPcapWriter ()
+{
+  NS_LOG_FUNCTION (this);
+  Close ();
+}
+
+void
+AsyncPcapWriter::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  Close ();
+  Object::DoDispose ();
+}
+
+void
+AsyncPcapWriter::Open (std::string filename, uint32_t dataLinkType, uint32_t snapLen)
+{
+  NS_LOG_FUNCTION (this << filename << dataLinkType << snapLen);
+  NS_ASSERT (m_thread == 0);
+  m_file.open (filename.c_str (), std::ios::binary | std::ios::trunc);
+  NS_ABORT_MSG_UNLESS (m_file.is_open (), "cannot open " << filename);
+
+  //host byte order, which the magic number tells to the readers
+  uint32_t magic = 0xa1b2c3d4;
+  uint16_t version[2] = {2, 4};
+  int32_t zone = 0;
+  uint32_t sigFigs = 0;
+  m_file.write (reinterpret_cast<const char *> (&magic), sizeof (magic));
+  m_file.write (reinterpret_cast<const char *> (version), sizeof (version));
+  m_file.write (reinterpret_cast<const char *> (&zone), sizeof (zone));
+  m_file.write (reinterpret_cast<const char *> (&sigFigs), sizeof (sigFigs));
+  m_file.write (reinterpret_cast<const char *> (&snapLen), sizeof (snapLen));
+  m_file.write (reinterpret_cast<const char *> (&dataLinkType), sizeof (dataLinkType));
+
+  //room for at least two of the largest records
+  uint64_t size = 1;
+  while (size < std::max<uint64_t> (m_bufferSize, 2 * (RECORD_HEADER_SIZE + snapLen)))
+    {
+      size <<= 1;
+    }
+  m_ring.assign (size, 0);
+  m_mask = size - 1;
+  m_snapLen = snapLen;
+  m_dataLinkType = dataLinkType;
+  m_nDataFrames = 0;
+  m_head = 0;
+  m_tail = 0;
+  m_stopping = false;
+  m_thread = Create<SystemThread> (MakeCallback (&AsyncPcapWriter::Run, this));
+  m_thread->Start ();
+}
+
+void
+AsyncPcapWriter::Close (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_thread == 0)
+    {
+      return;
+    }
+  m_stopping.store (true, std::memory_order_release);
+  m_readable.Signal ();
+  m_thread->Join ();
+  m_thread = 0;
+  m_file.close ();
+  NS_LOG_INFO ("written " << m_written << " records, dropped " << m_dropped
+               << ", filtered " << m_filtered);
+}
+
+void
+AsyncPcapWriter::CopyToRing (uint64_t position, const uint8_t *data, uint32_t size)
+{
+  uint64_t start = position & m_mask;
+  uint64_t first = std::min<uint64_t> (size, m_ring.size () - start);
+  std::memcpy (&m_ring[start], data, first);
+  std::memcpy (&m_ring[0], data + first, size - first);
+}
+
+bool
+AsyncPcapWriter::IsCaptured (Ptr<const Packet> packet)
+{
+  if (m_dataLinkType != DLT_IEEE802_11 && m_dataLinkType != DLT_IEEE802_11_RADIO)
+    {
+      return true;
+    }
+  //skip the radiotap header, whose little endian length follows its
+  //version and padding bytes
+  uint32_t offset = 0;
+  if (m_dataLinkType == DLT_IEEE802_11_RADIO)
+    {
+      uint8_t radiotap[4];
+      if (packet->CopyData (radiotap, 4) < 4)
+        {
+          return true;
+        }
+      offset = radiotap[2] | (radiotap[3] << 8);
+    }
+  m_scratch.resize (offset + 1);
+  if (packet->CopyData (&m_scratch[0], offset + 1) < offset + 1)
+    {
+      return true;
+    }
+  switch ((m_scratch[offset] >> 2) & 0x3)
+    {
+    case 0:
+      return m_managementFrames;
+    case 1:
+      return m_controlFrames;
+    case 2:
+      return m_dataFrames && m_nDataFrames++ % m_dataSampling == 0;
+    default:
+      return true;
+    }
+}
+
+void
+AsyncPcapWriter::Write (Time t, Ptr<const Packet> packet)
+{
+  NS_ASSERT (m_thread != 0);
+  if (!IsCaptured (packet))
+    {
+      m_filtered++;
+      return;
+    }
+  uint32_t size = packet->GetSize ();
+  uint32_t included = std::min (size, m_snapLen);
+  uint64_t recordSize = RECORD_HEADER_SIZE + included;
+  uint64_t head = m_head.load (std::memory_order_relaxed);
+  uint64_t tail = m_tail.load (std::memory_order_acquire);
+  while (head + recordSize - tail > m_ring.size ())
+    {
+      if (m_backpressure == DROP)
+        {
+          m_dropped++;
+          m_dropTrace (packet);
+          return;
+        }
+      //make sure that the writer is awake, and wait for it to make room
+      m_writable.SetCondition (false);
+      m_readable.Signal ();
+      m_writable.TimedWait (BLOCK_PERIOD);
+      tail = m_tail.load (std::memory_order_acquire);
+    }
+
+  uint64_t us = t.GetMicroSeconds ();
+  uint32_t header[4] = {static_cast<uint32_t> (us / 1000000), static_cast<uint32_t> (us % 1000000),
+                        included, size};
+  CopyToRing (head, reinterpret_cast<const uint8_t *> (header), RECORD_HEADER_SIZE);
+  uint64_t start = (head + RECORD_HEADER_SIZE) & m_mask;
+  if (start + included <= m_ring.size ())
+    {
+      packet->CopyData (&m_ring[start], included);
+    }
+  else
+    {
+      m_scratch.resize (included);
+      packet->CopyData (&m_scratch[0], included);
+      CopyToRing (head + RECORD_HEADER_SIZE, &m_scratch[0], included);
+    }
+  m_head.store (head + recordSize, std::memory_order_release);
+  m_written++;
+  //wake up the writer once per batch rather than once per record
+  if (head - tail < m_batchSize && head + recordSize - tail >= m_batchSize)
+    {
+      m_readable.Signal ();
+    }
+}
+
+void
+AsyncPcapWriter::Sniff (Ptr<const Packet> packet)
+{
+  Write (Simulator::Now (), packet);
+}
+
+uint64_t
+AsyncPcapWriter::GetWritten (void) const
+{
+  return m_written;
+}
+
+uint64_t
+AsyncPcapWriter::GetDropped (void) const
+{
+  return m_dropped;
+}
+
+uint64_t
+AsyncPcapWriter::GetFiltered (void) const
+{
+  return m_filtered;
+}
+
+uint64_t
+AsyncPcapWriter::Drain (void)
+{
+  uint64_t head = m_head.load (std::memory_order_acquire);
+  uint64_t tail = m_tail.load (std::memory_order_relaxed);
+  if (head == tail)
+    {
+      return 0;
+    }
+  uint64_t start = tail & m_mask;
+  uint64_t first = std::min (head - tail, m_ring.size () - start);
+  m_file.write (reinterpret_cast<const char *> (&m_ring[start]), first);
+  m_file.write (reinterpret_cast<const char *> (&m_ring[0]), head - tail - first);
+  m_tail.store (head, std::memory_order_release);
+  return head - tail;
+}
+
+void
+AsyncPcapWriter::Run (void)
+{
+  while (true)
+    {
+      //everything written before Close is in the ring once m_stopping is seen
+      bool stopping = m_stopping.load (std::memory_order_acquire);
+      if (Drain () > 0)
+        {
+          m_writable.Signal ();
+        }
+      if (stopping)
+        {
+          break;
+        }
+      m_readable.SetCondition (false);
+      if (m_head.load (std::memory_order_acquire) - m_tail.load (std::memory_order_relaxed) < m_batchSize
+          && !m_stopping.load (std::memory_order_acquire))
+        {
+          m_readable.TimedWait (WRITER_PERIOD);
+        }
+    }
+  m_file.flush ();
+}
+
+} //namespace ns3
@@ -0,0 +1,178 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ASYNC_PCAP_WRITER_H
+#define ASYNC_PCAP_WRITER_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+#include "ns3/packet.h"
+#include "ns3/traced-callback.h"
+#include "ns3/system-thread.h"
+#include "ns3/system-condition.h"
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief pcap file written from a background thread
+ * \ingroup network
+ *
+ * The records are copied into a single-producer, single-consumer ring of
+ * BufferSize bytes, in the pcap record format, and a background thread
+ * writes the ring to the file once BatchSize bytes are pending (or every
+ * 10 ms of wall clock time), so the simulation thread never waits for
+ * the file system. The ring is lock-free: the simulation thread only
+ * advances its head and the writer thread its tail.
+ *
+ * When the ring is full, the Backpressure attribute either blocks the
+ * simulation until the writer thread makes room (the default, so that no
+ * record is lost), or drops the record and fires the Drop trace source.
+ *
+ * Packets can be written directly, or from the sniffer trace sources of
+ * the devices through Sniff. The files have the classic pcap format with
+ * microsecond timestamps.
+ *
+ * To make the captures smaller, the packets can be truncated to the
+ * snapLen given to Open, e.g., 64 bytes keep the 802.11, LLC, IP and UDP
+ * headers of a data frame. For 802.11 captures (with or without
+ * radiotap header), the ManagementFrames, ControlFrames and DataFrames
+ * attributes select the frame types written, and only one data frame
+ * out of DataSampling is written. The frames which are not written are
+ * counted by GetFiltered.
+ */
+class AsyncPcapWriter : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /// What to do with a record which does not fit in the ring
+  enum Backpressure
+  {
+    BLOCK, //!< wait for the writer thread
+    DROP   //!< drop the record
+  };
+
+  AsyncPcapWriter ();
+  virtual ~AsyncPcapWriter ();
+
+  /**
+   * Create the file, write its header and start the writer thread.
+   *
+   * \param filename the name of the file
+   * \param dataLinkType the data link type of the file, e.g.,
+   *        PcapHelper::DLT_PPP
+   * \param snapLen the maximum number of bytes of a packet written
+   */
+  void Open (std::string filename, uint32_t dataLinkType, uint32_t snapLen = 65535);
+  /**
+   * Write the pending records and stop the writer thread.
+   */
+  void Close (void);
+
+  /**
+   * \param t the time of the packet
+   * \param packet the packet
+   */
+  void Write (Time t, Ptr<const Packet> packet);
+  /**
+   * Write a packet at the current simulation time. This has the signature
+   * of the sniffer trace sources of the devices.
+   *
+   * \param packet the packet
+   */
+  void Sniff (Ptr<const Packet> packet);
+
+  /**
+   * \return the number of records written to the ring
+   */
+  uint64_t GetWritten (void) const;
+  /**
+   * \return the number of records dropped
+   */
+  uint64_t GetDropped (void) const;
+  /**
+   * \return the number of frames not written because of their type or
+   *         because of the sampling of data frames
+   */
+  uint64_t GetFiltered (void) const;
+
+
+private:
+  virtual void DoDispose (void);
+
+  /// Body of the writer thread
+  void Run (void);
+  /**
+   * Write the pending bytes of the ring to the file.
+   *
+   * \return the number of bytes written
+   */
+  uint64_t Drain (void);
+  /**
+   * Copy bytes into the ring, wrapping around its end.
+   *
+   * \param position the position of the first byte
+   * \param data the bytes
+   * \param size the number of bytes
+   */
+  void CopyToRing (uint64_t position, const uint8_t *data, uint32_t size);
+  /**
+   * \param packet a packet
+   * \return true if the type of the frame is captured, and the frame is
+   *         not skipped by the sampling of data frames
+   */
+  bool IsCaptured (Ptr<const Packet> packet);
+
+  uint32_t m_bufferSize;              //!< requested size of the ring, in bytes
+  uint32_t m_batchSize;               //!< pending bytes which wake up the writer
+  Backpressure m_backpressure;        //!< policy when the ring is full
+  uint32_t m_snapLen;                 //!< maximum number of bytes of a packet
+  uint32_t m_dataLinkType;            //!< data link type of the file
+  bool m_managementFrames;            //!< whether 802.11 management frames are written
+  bool m_controlFrames;               //!< whether 802.11 control frames are written
+  bool m_dataFrames;                  //!< whether 802.11 data frames are written
+  uint32_t m_dataSampling;            //!< one data frame out of this many is written
+  uint64_t m_nDataFrames;             //!< data frames seen
+  std::ofstream m_file;               //!< the pcap file
+  std::vector<uint8_t> m_ring;        //!< the ring, whose size is a power of two
+  uint64_t m_mask;                    //!< size of the ring minus one
+  std::atomic<uint64_t> m_head;       //!< bytes written to the ring, only advanced by the simulation
+  std::atomic<uint64_t> m_tail;       //!< bytes written to the file, only advanced by the writer
+  std::atomic<bool> m_stopping;       //!< whether the writer thread must stop
+  std::vector<uint8_t> m_scratch;     //!< packet bytes which wrap around the end of the ring, or the start of a frame
+  Ptr<SystemThread> m_thread;         //!< the writer thread
+  SystemCondition m_readable;         //!< signalled when a batch is pending
+  SystemCondition m_writable;         //!< signalled when the writer made room
+  uint64_t m_written;                 //!< records written to the ring
+  uint64_t m_dropped;                 //!< records dropped
+  uint64_t m_filtered;                //!< frames not written because of their type or sampling
+
+  /// The records dropped
+  TracedCallback<Ptr<const Packet> > m_dropTrace;
+};
+
+} //namespace ns3
+
+#endif /* ASYNC_PCAP_WRITER_H */
@@ -0,0 +1,199 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/assert.h"
+#include "ns3/log.h"
+#include <cmath>
+#include "dcf-analytical-model.h"
+#include "dcf-manager.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DcfAnalyticalModel");
+
+DcfAnalyticalModel::DcfAnalyticalModel ()
+  : m_slot (MicroSeconds (9)),
+    m_sifs (MicroSeconds (16)),
+    m_eifsNoDifs (MicroSeconds (0)),
+    m_cwMin (15),
+    m_cwMax (1023),
+    m_aifsn (2),
+    m_data (MicroSeconds (0)),
+    m_ack (MicroSeconds (0)),
+    m_rtsCts (false),
+    m_rts (MicroSeconds (0)),
+    m_cts (MicroSeconds (0)),
+    m_payloadSize (0)
+{
+}
+
+void
+DcfAnalyticalModel::SetSlot (Time slotTime)
+{
+  m_slot = slotTime;
+}
+
+void
+DcfAnalyticalModel::SetSifs (Time sifs)
+{
+  m_sifs = sifs;
+}
+
+void
+DcfAnalyticalModel::SetEifsNoDifs (Time eifsNoDifs)
+{
+  m_eifsNoDifs = eifsNoDifs;
+}
+
+void
+DcfAnalyticalModel::SetCwMin (uint32_t minCw)
+{
+  m_cwMin = minCw;
+}
+
+void
+DcfAnalyticalModel::SetCwMax (uint32_t maxCw)
+{
+  m_cwMax = maxCw;
+}
+
+void
+DcfAnalyticalModel::SetAifsn (uint32_t aifsn)
+{
+  m_aifsn = aifsn;
+}
+
+void
+DcfAnalyticalModel::SetDcfState (const DcfState &state)
+{
+  m_cwMin = state.GetCwMin ();
+  m_cwMax = state.GetCwMax ();
+  m_aifsn = state.GetAifsn ();
+}
+
+void
+DcfAnalyticalModel::SetFrameDurations (Time data, Time ack)
+{
+  m_data = data;
+  m_ack = ack;
+}
+
+void
+DcfAnalyticalModel::EnableRtsCts (Time rts, Time cts)
+{
+  m_rtsCts = true;
+  m_rts = rts;
+  m_cts = cts;
+}
+
+void
+DcfAnalyticalModel::DisableRtsCts (void)
+{
+  m_rtsCts = false;
+}
+
+void
+DcfAnalyticalModel::SetPayloadSize (uint32_t bytes)
+{
+  m_payloadSize = bytes;
+}
+
+double
+DcfAnalyticalModel::GetTransmissionProbability (double p) const
+{
+  /**
+   * A station in backoff stage i draws its backoff uniformly in
+   * [0, cw_i] and so spends (cw_i + 2) / 2 slots on average in that
+   * stage, including the transmission slot. It reaches stage i with
+   * probability p^i, and the last stage (cw == CwMax) is repeated
+   * until the transmission succeeds.
+   */
+  double slots = 0;
+  double reach = 1;
+  uint32_t cw = m_cwMin;
+  while (cw < m_cwMax)
+    {
+      slots += reach * (cw + 2) / 2.0;
+      reach *= p;
+      uint32_t next = DcfState::GetFailedCw (cw, m_cwMax);
+      NS_ASSERT (next > cw);
+      cw = next;
+    }
+  slots += reach / (1 - p) * (cw + 2) / 2.0;
+  //one transmission per 1 / (1 - p) attempts
+  return 1 / (1 - p) / slots;
+}
+
+DcfAnalyticalModel::Estimate
+DcfAnalyticalModel::Solve (uint32_t nStations) const
+{
+  NS_LOG_FUNCTION (this << nStations);
+  NS_ASSERT (nStations > 0);
+  NS_ASSERT (m_cwMin <= m_cwMax);
+
+  /**
+   * Fixed point of p = 1 - (1 - tau (p))^(n - 1). The right hand side
+   * decreases with p, so the solution is found by bisection.
+   */
+  double low = 0;
+  double high = 1;
+  for (uint32_t i = 0; i < 60 && nStations > 1; i++)
+    {
+      double p = (low + high) / 2;
+      double tau = GetTransmissionProbability (p);
+      double f = 1 - std::pow (1 - tau, static_cast<double> (nStations - 1)) - p;
+      if (f > 0)
+        {
+          low = p;
+        }
+      else
+        {
+          high = p;
+        }
+    }
+  Estimate estimate;
+  estimate.collisionProbability = (nStations > 1) ? (low + high) / 2 : 0;
+  estimate.transmissionProbability = GetTransmissionProbability (estimate.collisionProbability);
+
+  double tau = estimate.transmissionProbability;
+  double n = nStations;
+  double pTr = 1 - std::pow (1 - tau, n);
+  double pS = n * tau * std::pow (1 - tau, n - 1) / pTr;
+
+  double aifs = (m_sifs + m_slot * m_aifsn).GetSeconds ();
+  double ts;
+  double tc;
+  if (m_rtsCts)
+    {
+      ts = (m_rts + m_sifs + m_cts + m_sifs + m_data + m_sifs + m_ack).GetSeconds () + aifs;
+      tc = (m_rts + m_sifs + m_eifsNoDifs).GetSeconds () + aifs;
+    }
+  else
+    {
+      ts = (m_data + m_sifs + m_ack).GetSeconds () + aifs;
+      tc = (m_data + m_sifs + m_eifsNoDifs).GetSeconds () + aifs;
+    }
+  double slotTime = (1 - pTr) * m_slot.GetSeconds ()
+    + pTr * pS * ts
+    + pTr * (1 - pS) * tc;
+  estimate.throughput = pS * pTr * m_payloadSize * 8 / slotTime;
+  NS_LOG_DEBUG ("n=" << nStations << " tau=" << tau <<
+                " p=" << estimate.collisionProbability <<
+                " throughput=" << estimate.throughput);
+  return estimate;
+}
+
+} //namespace ns3
@@ -0,0 +1,145 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DCF_ANALYTICAL_MODEL_H
+#define DCF_ANALYTICAL_MODEL_H
+
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+class DcfState;
+
+/**
+ * \brief Closed-form saturation throughput of a single DCF/EDCA cell
+ * \ingroup wifi
+ *
+ * Bianchi-style Markov chain model of n saturated stations which all
+ * hear each other and share the same contention parameters. The backoff
+ * stages follow DcfState::GetFailedCw, so the model matches the
+ * contention window update rule used by the simulator, and there is no
+ * retry limit, as in DcfState.
+ *
+ * The timing parameters are the ones given to DcfManager (SetSlot,
+ * SetSifs, SetEifsNoDifs) and the contention parameters the ones of a
+ * DcfState (CwMin, CwMax, AIFSN). A successful transmission occupies
+ * the medium for the frame exchange followed by SIFS + AIFSN slots, and
+ * a collision for the longest colliding frame followed by an EIFS
+ * (SIFS + EifsNoDifs) and AIFSN slots.
+ *
+ * The model does not account for hidden stations, capture, rate
+ * adaptation or non-saturated traffic.
+ */
+class DcfAnalyticalModel
+{
+public:
+  /**
+   * Result of DcfAnalyticalModel::Solve
+   */
+  struct Estimate
+  {
+    double transmissionProbability; //!< probability that a station transmits in a random slot
+    double collisionProbability;    //!< probability that a transmission collides
+    double throughput;              //!< aggregate payload throughput, in bit/s
+  };
+
+  DcfAnalyticalModel ();
+
+  /**
+   * \param slotTime the duration of a slot
+   */
+  void SetSlot (Time slotTime);
+  /**
+   * \param sifs the duration of a SIFS
+   */
+  void SetSifs (Time sifs);
+  /**
+   * \param eifsNoDifs the duration of an EIFS minus the duration of DIFS
+   */
+  void SetEifsNoDifs (Time eifsNoDifs);
+  /**
+   * \param minCw the minimum congestion window size
+   */
+  void SetCwMin (uint32_t minCw);
+  /**
+   * \param maxCw the maximum congestion window size
+   */
+  void SetCwMax (uint32_t maxCw);
+  /**
+   * \param aifsn the number of slots which make up an AIFS
+   */
+  void SetAifsn (uint32_t aifsn);
+  /**
+   * Copy CwMin, CwMax and AIFSN from a DcfState.
+   *
+   * \param state the DcfState
+   */
+  void SetDcfState (const DcfState &state);
+  /**
+   * \param data the duration of a data frame (or A-MPDU)
+   * \param ack the duration of the (block) acknowledgment
+   */
+  void SetFrameDurations (Time data, Time ack);
+  /**
+   * \param rts the duration of a RTS frame
+   * \param cts the duration of a CTS frame
+   *
+   * Every data frame is then protected by a RTS/CTS exchange.
+   */
+  void EnableRtsCts (Time rts, Time cts);
+  /**
+   * Use basic access, without RTS/CTS. This is the default.
+   */
+  void DisableRtsCts (void);
+  /**
+   * \param bytes the number of payload bytes delivered by a successful
+   *        transmission
+   */
+  void SetPayloadSize (uint32_t bytes);
+
+  /**
+   * \param nStations the number of saturated stations
+   *
+   * \return the saturation estimate for nStations
+   */
+  Estimate Solve (uint32_t nStations) const;
+
+
+private:
+  /**
+   * \param p the collision probability
+   *
+   * \return the probability that a station transmits in a random slot
+   */
+  double GetTransmissionProbability (double p) const;
+
+  Time m_slot;                 //!< slot duration
+  Time m_sifs;                 //!< SIFS duration
+  Time m_eifsNoDifs;           //!< EIFS minus DIFS duration
+  uint32_t m_cwMin;            //!< minimum congestion window
+  uint32_t m_cwMax;            //!< maximum congestion window
+  uint32_t m_aifsn;            //!< number of slots in AIFS
+  Time m_data;                 //!< data frame duration
+  Time m_ack;                  //!< acknowledgment duration
+  bool m_rtsCts;               //!< whether RTS/CTS is used
+  Time m_rts;                  //!< RTS duration
+  Time m_cts;                  //!< CTS duration
+  uint32_t m_payloadSize;      //!< payload bytes per successful transmission
+};
+
+} //namespace ns3
+
+#endif /* DCF_ANALYTICAL_MODEL_H */
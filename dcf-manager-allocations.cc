@@ -0,0 +1,308 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/internet-module.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <iostream>
+#include <new>
+#include <vector>
+
+// Allocation check of the DcfManagers of simple-ht-hidden-stations: a
+// reduced copy of its scenario, with --nStations UDP echo clients around
+// an AP and the same 802.11n MACs, without the captures and reports.
+//
+// Example: ./waf --run "dcf-manager-allocations --nStations=4 --hiddenNodes=0"
+//
+// operator new is replaced to count the heap allocations during the run,
+// and each one is attributed from its backtrace: skipping the frames of
+// the standard library and of the simulator, an allocation belongs to the
+// DcfManagers if its first remaining frame is in DcfManager,
+// DcfMediumState, DcfState or their PHY and MacLow listeners. The count is
+// reported for each simulated second, and the program exits with a
+// non-zero status if any second after the first --warmup seconds
+// allocates. The symbols are found with dladdr, so the wifi module must
+// be a shared library (the default ./waf configure). The simulator uses
+// the HeapScheduler, which stops allocating once its heap has grown,
+// whereas the default MapScheduler allocates a node for each event.
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("DcfManagerAllocations");
+
+static uint64_t g_allocations = 0;    //!< allocations counted so far
+static uint64_t g_dcfAllocations = 0; //!< allocations of the DcfManagers counted so far
+static bool g_counting = false;       //!< whether the allocations are counted
+static bool g_attributing = false;    //!< whether an allocation is being attributed
+
+//whether the frames of this symbol are skipped to find the allocating code
+static bool
+IsSkipped (const char *symbol)
+{
+  static const char *prefixes[] = {
+    "_Zn",                 //operator new
+    "_ZNSt", "_ZNKSt", "_ZSt", "_ZN9__gnu_cxx",
+    "_ZN3ns39Simulator", "_ZN3ns313SimulatorImpl", "_ZN3ns320DefaultSimulatorImpl",
+    "_ZN3ns39Scheduler", "_ZN3ns313HeapScheduler", "_ZN3ns39MakeEvent",
+    "_ZN3ns36Create", "_ZN3ns312CreateObject", "_ZN3ns33Ptr"
+  };
+  for (uint32_t i = 0; i < sizeof (prefixes) / sizeof (prefixes[0]); i++)
+    {
+      if (std::strncmp (symbol, prefixes[i], std::strlen (prefixes[i])) == 0)
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+//whether a symbol is in the DcfManager code; the DcfState notifications
+//are not, since they call the Do* functions of the MACs
+static bool
+IsDcf (const char *symbol)
+{
+  static const char *prefixes[] = {
+    "_ZN3ns310DcfManager", "_ZNK3ns310DcfManager",
+    "_ZN3ns314DcfMediumState", "_ZNK3ns314DcfMediumState",
+    "_ZN3ns38DcfState", "_ZNK3ns38DcfState",
+    "_ZN3ns311PhyListener", "_ZN3ns314LowDcfListener"
+  };
+  for (uint32_t i = 0; i < sizeof (prefixes) / sizeof (prefixes[0]); i++)
+    {
+      if (std::strncmp (symbol, prefixes[i], std::strlen (prefixes[i])) == 0)
+        {
+          return std::strncmp (symbol, "_ZN3ns38DcfState8DoNotify", 25) != 0;
+        }
+    }
+  return false;
+}
+
+//whether the allocation of the calling operator new is made by the DcfManagers
+static bool
+IsDcfAllocation (void)
+{
+  void *frames[32];
+  int n = backtrace (frames, 32);
+  //frame 0 is this function
+  for (int i = 1; i < n; i++)
+    {
+      Dl_info info;
+      if (dladdr (frames[i], &info) == 0 || info.dli_sname == 0)
+        {
+          //a static function: attributed to its caller
+          continue;
+        }
+      if (!IsSkipped (info.dli_sname))
+        {
+          return IsDcf (info.dli_sname);
+        }
+    }
+  return false;
+}
+
+void *
+operator new (std::size_t size)
+{
+  if (g_counting && !g_attributing)
+    {
+      g_attributing = true;
+      g_allocations++;
+      if (IsDcfAllocation ())
+        {
+          g_dcfAllocations++;
+        }
+      g_attributing = false;
+    }
+  void *p = std::malloc (size == 0 ? 1 : size);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void *
+operator new[] (std::size_t size)
+{
+  return operator new (size);
+}
+
+void
+operator delete (void *p) noexcept
+{
+  std::free (p);
+}
+
+void
+operator delete[] (void *p) noexcept
+{
+  std::free (p);
+}
+
+//allocations counted in each simulated second, in total and by the DcfManagers
+static std::vector<uint64_t> g_perSecond;
+static std::vector<uint64_t> g_dcfPerSecond;
+
+static void
+Sample (uint64_t lastAllocations, uint64_t lastDcfAllocations)
+{
+  uint64_t allocations = g_allocations;
+  uint64_t dcfAllocations = g_dcfAllocations;
+  g_perSecond.push_back (allocations - lastAllocations);
+  g_dcfPerSecond.push_back (dcfAllocations - lastDcfAllocations);
+  Simulator::Schedule (Seconds (1), &Sample, allocations, dcfAllocations);
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t payloadSize = 1472; //bytes
+  uint32_t nStations = 4;
+  bool enableRts = 1;
+  bool hiddenNodes = true;
+  std::string interval = "0.0039";
+  double simulationTime = 10; //seconds
+  uint32_t warmup = 2; //seconds, including the association
+  uint32_t seed = 1;
+
+  CommandLine cmd;
+  cmd.AddValue ("nStations", "Number of stations", nStations);
+  cmd.AddValue ("payloadSize", "Payload size in bytes", payloadSize);
+  cmd.AddValue ("enableRts", "Enable RTS/CTS", enableRts);
+  cmd.AddValue ("hiddenNodes", "Limit the wireless range so that the stations are hidden from each other", hiddenNodes);
+  cmd.AddValue ("interval", "Interval between the packets of each client", interval);
+  cmd.AddValue ("simulationTime", "Simulation time in seconds", simulationTime);
+  cmd.AddValue ("warmup", "Number of simulated seconds which may allocate", warmup);
+  cmd.AddValue ("seed", "Random number generator run", seed);
+  cmd.Parse (argc, argv);
+
+  RngSeedManager::SetRun (seed);
+  ObjectFactory scheduler;
+  scheduler.SetTypeId ("ns3::HeapScheduler");
+  Simulator::SetScheduler (scheduler);
+
+  //backtrace loads its unwinder on its first call, which allocates; this
+  //also checks that the DcfManager symbols can be found at all
+  {
+    void *frames[1];
+    backtrace (frames, 1);
+    Dl_info info;
+    if (dladdr (reinterpret_cast<void *> (&DcfManager::GetTypeId), &info) == 0
+        || info.dli_sname == 0 || !IsDcf (info.dli_sname))
+      {
+        NS_FATAL_ERROR ("the DcfManager symbols cannot be found: the wifi module must be a shared library");
+      }
+  }
+
+  Config::SetDefault ("ns3::WifiRemoteStationManager::RtsCtsThreshold", StringValue (enableRts ? "0" : "999999"));
+  Config::SetDefault ("ns3::WifiRemoteStationManager::FragmentationThreshold", StringValue ("990000"));
+  Config::SetDefault ("ns3::RangePropagationLossModel::MaxRange", DoubleValue (hiddenNodes ? 5 : 100));
+
+  NodeContainer wifiStaNodes;
+  wifiStaNodes.Create (nStations);
+  NodeContainer wifiApNode;
+  wifiApNode.Create (1);
+
+  YansWifiChannelHelper channel = YansWifiChannelHelper::Default ();
+  channel.AddPropagationLoss ("ns3::RangePropagationLossModel");
+  YansWifiPhyHelper phy = YansWifiPhyHelper::Default ();
+  phy.SetChannel (channel.Create ());
+
+  WifiHelper wifi;
+  wifi.SetStandard (WIFI_PHY_STANDARD_80211n_5GHZ);
+  wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager", "DataMode", StringValue ("HtMcs7"), "ControlMode", StringValue ("HtMcs0"));
+  WifiMacHelper mac;
+  Ssid ssid = Ssid ("simple-mpdu-aggregation");
+  mac.SetType ("ns3::StaWifiMac",
+               "Ssid", SsidValue (ssid),
+               "ActiveProbing", BooleanValue (false));
+  NetDeviceContainer staDevices = wifi.Install (phy, mac, wifiStaNodes);
+  mac.SetType ("ns3::ApWifiMac",
+               "Ssid", SsidValue (ssid),
+               "BeaconInterval", TimeValue (MicroSeconds (102400)),
+               "BeaconGeneration", BooleanValue (true));
+  NetDeviceContainer apDevice = wifi.Install (phy, mac, wifiApNode);
+
+  //the AP in the center, the stations on a circle of radius 5 meters
+  MobilityHelper mobility;
+  Ptr<ListPositionAllocator> positionAlloc = CreateObject<ListPositionAllocator> ();
+  positionAlloc->Add (Vector (5.0, 5.0, 0.0));
+  for (uint32_t i = 0; i < nStations; i++)
+    {
+      double angle = M_PI / 2 + 2 * M_PI * i / nStations;
+      positionAlloc->Add (Vector (5.0 + 5.0 * std::cos (angle), 5.0 + 5.0 * std::sin (angle), 0.0));
+    }
+  mobility.SetPositionAllocator (positionAlloc);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (wifiApNode);
+  mobility.Install (wifiStaNodes);
+
+  InternetStackHelper stack;
+  stack.Install (wifiApNode);
+  stack.Install (wifiStaNodes);
+  Ipv4AddressHelper address;
+  address.SetBase ("192.168.1.0", "255.255.255.0");
+  address.Assign (staDevices);
+  Ipv4InterfaceContainer apInterface = address.Assign (apDevice);
+
+  for (uint32_t i = 0; i < nStations; i++)
+    {
+      UdpEchoServerHelper server (9 + i);
+      ApplicationContainer serverApp = server.Install (wifiApNode);
+      serverApp.Start (Seconds (0.0));
+      serverApp.Stop (Seconds (simulationTime + 2));
+
+      UdpEchoClientHelper client (apInterface.GetAddress (0), 9 + i);
+      client.SetAttribute ("MaxPackets", UintegerValue (4294967295u));
+      client.SetAttribute ("Interval", TimeValue (Time (interval)));
+      client.SetAttribute ("PacketSize", UintegerValue (payloadSize));
+      ApplicationContainer clientApp = client.Install (wifiStaNodes.Get (i));
+      clientApp.Start (Seconds (1));
+      clientApp.Stop (Seconds (simulationTime + 1));
+    }
+
+  Simulator::Schedule (Seconds (1), &Sample, 0, 0);
+  Simulator::Stop (Seconds (simulationTime + 1));
+  g_counting = true;
+  Simulator::Run ();
+  g_counting = false;
+  Simulator::Destroy ();
+
+  bool steady = true;
+  for (uint32_t i = 0; i < g_dcfPerSecond.size (); i++)
+    {
+      std::cout << "second " << i + 1 << ": " << g_dcfPerSecond[i] << " DcfManager allocations"
+                << " (" << g_perSecond[i] << " in total)"
+                << (i < warmup ? " (warm-up)" : "") << "\n";
+      if (i >= warmup && g_dcfPerSecond[i] > 0)
+        {
+          steady = false;
+        }
+    }
+  if (!steady)
+    {
+      std::cout << "FAIL: the DcfManagers allocate after the warm-up\n";
+    }
+  return steady ? 0 : 1;
+}
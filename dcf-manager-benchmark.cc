@@ -0,0 +1,430 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/dcf-manager.h"
+#include <iostream>
+#include <vector>
+
+// Micro-benchmark of the DcfManager access logic. A bare DcfManager is
+// driven by synthetic events, without any PHY, channel or MAC object:
+//  - nStates DcfStates with Poisson packet arrivals, which request access,
+//    transmit, and then wait for an ack (or an ack timeout)
+//  - foreign frames received from outside the BSS, some of them in error
+//    and some of them setting the NAV
+//
+// Example: ./waf --run "dcf-manager-benchmark --nStates=4 --load=0.5 --collisionRate=0.1"
+//
+// With --dcaTxop=1, a legacy DCF DcfState is added before the nStates
+// others: --nStates=4 --dcaTxop=1 gives the layout of the DcfManager of
+// a MAC, one DcaTxop and the four EdcaTxopNs of the access categories.
+//
+// The program reports the wall-clock cost per call into the DcfManager and
+// the number of calls and workload events processed per second. The cost
+// includes the scheduling of the workload events, so the figures are meant
+// to be compared between versions of DcfManager with the same options.
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("DcfManagerBenchmark");
+
+class DcfBenchmark;
+
+class BenchmarkDcfState : public DcfState
+{
+public:
+  BenchmarkDcfState (DcfBenchmark *benchmark, bool edca);
+
+  //request access if there is something to send
+  void Kick (void);
+
+  uint32_t m_queue;   //!< number of queued packets
+  bool m_txing;       //!< whether a frame exchange is ongoing
+
+
+private:
+  virtual bool IsEdca (void) const;
+  virtual void DoNotifyAccessGranted (void);
+  virtual void DoNotifyInternalCollision (void);
+  virtual void DoNotifyCollision (void);
+  virtual void DoNotifyChannelSwitching (void);
+  virtual void DoNotifySleep (void);
+  virtual void DoNotifyWakeUp (void);
+
+  DcfBenchmark *m_benchmark;
+  bool m_edca;
+};
+
+class DcfBenchmark
+{
+public:
+  DcfBenchmark ();
+  ~DcfBenchmark ();
+
+  void Setup (uint32_t nStates, bool edca, bool dcaTxop, double load,
+              double collisionRate, double foreignRate, double navRate);
+  void Run (Time duration);
+  void Report (void) const;
+
+  void RequestAccess (BenchmarkDcfState *state);
+  void StartTx (BenchmarkDcfState *state);
+  void NewBackoff (BenchmarkDcfState *state);
+
+
+private:
+  void Arrival (BenchmarkDcfState *state);
+  void EndTx (BenchmarkDcfState *state);
+  void StartAck (BenchmarkDcfState *state);
+  void EndAck (BenchmarkDcfState *state);
+  void AckTimeout (BenchmarkDcfState *state);
+  void StartForeignFrame (void);
+  void EndForeignFrame (void);
+
+  Ptr<DcfManager> m_manager;
+  std::vector<BenchmarkDcfState *> m_states;
+  Ptr<UniformRandomVariable> m_uniform;
+  Ptr<ExponentialRandomVariable> m_arrival;
+  Ptr<ExponentialRandomVariable> m_foreign;
+  Time m_txDuration;
+  Time m_ackDuration;
+  Time m_ackTimeout;
+  Time m_navDuration;
+  double m_collisionRate;
+  double m_navRate;
+  bool m_foreignFrames;
+  Time m_busyEnd;       //!< end of the ongoing frame exchange, if any
+
+  uint64_t m_calls;     //!< calls into the DcfManager
+  uint64_t m_events;    //!< workload events
+  uint64_t m_failures;  //!< transmissions without ack
+  int64_t m_elapsedMs;  //!< wall-clock duration of the run
+};
+
+BenchmarkDcfState::BenchmarkDcfState (DcfBenchmark *benchmark, bool edca)
+  : m_queue (0),
+    m_txing (false),
+    m_benchmark (benchmark),
+    m_edca (edca)
+{
+}
+
+void
+BenchmarkDcfState::Kick (void)
+{
+  if (m_queue > 0 && !m_txing && !IsAccessRequested ())
+    {
+      m_benchmark->RequestAccess (this);
+    }
+}
+
+bool
+BenchmarkDcfState::IsEdca (void) const
+{
+  return m_edca;
+}
+
+void
+BenchmarkDcfState::DoNotifyAccessGranted (void)
+{
+  m_benchmark->StartTx (this);
+}
+
+void
+BenchmarkDcfState::DoNotifyInternalCollision (void)
+{
+  UpdateFailedCw ();
+  m_benchmark->NewBackoff (this);
+  Kick ();
+}
+
+void
+BenchmarkDcfState::DoNotifyCollision (void)
+{
+  m_benchmark->NewBackoff (this);
+  Kick ();
+}
+
+void
+BenchmarkDcfState::DoNotifyChannelSwitching (void)
+{
+}
+
+void
+BenchmarkDcfState::DoNotifySleep (void)
+{
+}
+
+void
+BenchmarkDcfState::DoNotifyWakeUp (void)
+{
+}
+
+DcfBenchmark::DcfBenchmark ()
+  : m_txDuration (MicroSeconds (248)),
+    m_ackDuration (MicroSeconds (44)),
+    m_ackTimeout (MicroSeconds (16 + 44 + 9 + 2)),
+    m_navDuration (MicroSeconds (300)),
+    m_collisionRate (0),
+    m_navRate (0),
+    m_foreignFrames (false),
+    m_busyEnd (Seconds (0)),
+    m_calls (0),
+    m_events (0),
+    m_failures (0),
+    m_elapsedMs (0)
+{
+}
+
+DcfBenchmark::~DcfBenchmark ()
+{
+  for (std::vector<BenchmarkDcfState *>::const_iterator i = m_states.begin (); i != m_states.end (); i++)
+    {
+      delete *i;
+    }
+}
+
+void
+DcfBenchmark::Setup (uint32_t nStates, bool edca, bool dcaTxop, double load,
+                     double collisionRate, double foreignRate, double navRate)
+{
+  m_manager = CreateObject<DcfManager> ();
+  m_manager->SetSlot (MicroSeconds (9));
+  m_manager->SetSifs (MicroSeconds (16));
+  m_manager->SetEifsNoDifs (MicroSeconds (16 + 44));
+  m_collisionRate = collisionRate;
+  m_navRate = navRate;
+
+  m_uniform = CreateObject<UniformRandomVariable> ();
+  //load is the fraction of the medium that the traffic of each state
+  //would occupy on its own
+  m_arrival = CreateObject<ExponentialRandomVariable> ();
+  m_arrival->SetAttribute ("Mean", DoubleValue (m_txDuration.GetSeconds () / load));
+  m_foreign = CreateObject<ExponentialRandomVariable> ();
+  m_foreignFrames = foreignRate > 0;
+  if (m_foreignFrames)
+    {
+      m_foreign->SetAttribute ("Mean", DoubleValue (1 / foreignRate));
+    }
+
+  if (dcaTxop)
+    {
+      //like the DcaTxop, which the MACs add before their EdcaTxopNs
+      BenchmarkDcfState *state = new BenchmarkDcfState (this, false);
+      state->SetAifsn (2);
+      state->SetCwMin (15);
+      state->SetCwMax (1023);
+      m_manager->Add (state);
+      m_states.push_back (state);
+      Simulator::Schedule (Seconds (m_arrival->GetValue ()), &DcfBenchmark::Arrival, this, state);
+    }
+  for (uint32_t i = 0; i < nStates; i++)
+    {
+      BenchmarkDcfState *state = new BenchmarkDcfState (this, edca);
+      //alternate between the AC_BE and AC_VI parameters
+      state->SetAifsn ((i % 2 == 0) ? 3 : 2);
+      state->SetCwMin ((i % 2 == 0) ? 15 : 7);
+      state->SetCwMax ((i % 2 == 0) ? 1023 : 15);
+      m_manager->Add (state);
+      m_states.push_back (state);
+      Simulator::Schedule (Seconds (m_arrival->GetValue ()), &DcfBenchmark::Arrival, this, state);
+    }
+  if (m_foreignFrames)
+    {
+      Simulator::Schedule (Seconds (m_foreign->GetValue ()), &DcfBenchmark::StartForeignFrame, this);
+    }
+}
+
+void
+DcfBenchmark::Run (Time duration)
+{
+  SystemWallClockMs clock;
+  Simulator::Stop (duration);
+  clock.Start ();
+  Simulator::Run ();
+  m_elapsedMs = clock.End ();
+}
+
+void
+DcfBenchmark::Report (void) const
+{
+  double elapsed = m_elapsedMs / 1000.0;
+  std::cout << "DcfManager calls: " << m_calls << "\n";
+  std::cout << "workload events: " << m_events << "\n";
+  std::cout << "grants: " << m_manager->GetGrants ()
+            << ", internal collisions: " << m_manager->GetInternalCollisions ()
+            << ", failed transmissions: " << m_failures << "\n";
+  std::cout << "wall-clock time: " << m_elapsedMs << " ms\n";
+  if (m_elapsedMs > 0 && m_calls > 0)
+    {
+      std::cout << "ns/call: " << m_elapsedMs * 1000000.0 / m_calls << "\n";
+      std::cout << "calls/s: " << m_calls / elapsed << "\n";
+      std::cout << "events/s: " << m_events / elapsed << "\n";
+    }
+}
+
+void
+DcfBenchmark::RequestAccess (BenchmarkDcfState *state)
+{
+  m_calls++;
+  m_manager->RequestAccess (state);
+}
+
+void
+DcfBenchmark::NewBackoff (BenchmarkDcfState *state)
+{
+  state->StartBackoffNow (m_uniform->GetInteger (0, state->GetCw ()));
+}
+
+void
+DcfBenchmark::Arrival (BenchmarkDcfState *state)
+{
+  m_events++;
+  state->m_queue++;
+  state->Kick ();
+  Simulator::Schedule (Seconds (m_arrival->GetValue ()), &DcfBenchmark::Arrival, this, state);
+}
+
+void
+DcfBenchmark::StartTx (BenchmarkDcfState *state)
+{
+  state->m_txing = true;
+  m_busyEnd = Simulator::Now () + m_txDuration + m_ackTimeout;
+  m_calls++;
+  m_manager->NotifyTxStartNow (m_txDuration);
+  Simulator::Schedule (m_txDuration, &DcfBenchmark::EndTx, this, state);
+}
+
+void
+DcfBenchmark::EndTx (BenchmarkDcfState *state)
+{
+  m_events++;
+  m_calls++;
+  m_manager->NotifyAckTimeoutStartNow (m_ackTimeout);
+  if (m_uniform->GetValue () < m_collisionRate)
+    {
+      Simulator::Schedule (m_ackTimeout, &DcfBenchmark::AckTimeout, this, state);
+    }
+  else
+    {
+      Simulator::Schedule (MicroSeconds (16), &DcfBenchmark::StartAck, this, state);
+    }
+}
+
+void
+DcfBenchmark::StartAck (BenchmarkDcfState *state)
+{
+  m_events++;
+  m_calls++;
+  m_manager->NotifyRxStartNow (m_ackDuration);
+  Simulator::Schedule (m_ackDuration, &DcfBenchmark::EndAck, this, state);
+}
+
+void
+DcfBenchmark::EndAck (BenchmarkDcfState *state)
+{
+  m_events++;
+  m_calls += 2;
+  m_manager->NotifyRxEndOkNow ();
+  m_manager->NotifyAckTimeoutResetNow ();
+  m_busyEnd = Simulator::Now ();
+  state->m_txing = false;
+  state->m_queue--;
+  state->ResetCw ();
+  NewBackoff (state);
+  state->Kick ();
+}
+
+void
+DcfBenchmark::AckTimeout (BenchmarkDcfState *state)
+{
+  m_events++;
+  m_failures++;
+  state->m_txing = false;
+  state->UpdateFailedCw ();
+  NewBackoff (state);
+  state->Kick ();
+}
+
+void
+DcfBenchmark::StartForeignFrame (void)
+{
+  m_events++;
+  //foreign frames are only received while the BSS is silent
+  if (Simulator::Now () >= m_busyEnd)
+    {
+      m_busyEnd = Simulator::Now () + m_txDuration;
+      m_calls++;
+      m_manager->NotifyRxStartNow (m_txDuration);
+      Simulator::Schedule (m_txDuration, &DcfBenchmark::EndForeignFrame, this);
+    }
+  Simulator::Schedule (Seconds (m_foreign->GetValue ()), &DcfBenchmark::StartForeignFrame, this);
+}
+
+void
+DcfBenchmark::EndForeignFrame (void)
+{
+  m_events++;
+  m_calls++;
+  if (m_uniform->GetValue () < m_collisionRate)
+    {
+      m_manager->NotifyRxEndErrorNow ();
+    }
+  else
+    {
+      m_manager->NotifyRxEndOkNow ();
+      if (m_uniform->GetValue () < m_navRate)
+        {
+          m_calls++;
+          m_manager->NotifyNavStartNow (m_navDuration);
+        }
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t nStates = 4;
+  bool edca = true;
+  bool dcaTxop = false;
+  double load = 0.5;
+  double collisionRate = 0.1;
+  double foreignRate = 500;
+  double navRate = 0.2;
+  double simulationTime = 10; //seconds
+  uint32_t seed = 1;
+
+  CommandLine cmd;
+  cmd.AddValue ("nStates", "Number of DcfStates", nStates);
+  cmd.AddValue ("edca", "Use EDCA rather than DCF backoff rules", edca);
+  cmd.AddValue ("dcaTxop", "Add a legacy DCF DcfState before the others, like the DcaTxop of the MACs", dcaTxop);
+  cmd.AddValue ("load", "Offered load of each state, as a fraction of the medium", load);
+  cmd.AddValue ("collisionRate", "Probability that a frame is not acknowledged or received in error", collisionRate);
+  cmd.AddValue ("foreignRate", "Foreign frames per second", foreignRate);
+  cmd.AddValue ("navRate", "Probability that a foreign frame sets the NAV", navRate);
+  cmd.AddValue ("simulationTime", "Simulation time in seconds", simulationTime);
+  cmd.AddValue ("seed", "Random number generator run", seed);
+  cmd.Parse (argc, argv);
+
+  RngSeedManager::SetRun (seed);
+
+  DcfBenchmark benchmark;
+  benchmark.Setup (nStates, edca, dcaTxop, load, collisionRate, foreignRate, navRate);
+  benchmark.Run (Seconds (simulationTime));
+  benchmark.Report ();
+  Simulator::Destroy ();
+
+  return 0;
+}
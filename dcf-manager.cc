@@ -21,19 +21,21 @@
 #include "ns3/assert.h"
 #include "ns3/log.h"
 #include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/string.h"
+#include "ns3/trace-source-accessor.h"
 #include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
 #include "dcf-manager.h"
 #include "wifi-phy.h"
 #include "wifi-mac.h"
 #include "mac-low.h"
 
-#define MY_DEBUG(x) \
-  NS_LOG_DEBUG (Simulator::Now () << " " << this << " " << x)
-
 namespace ns3 {
 
-Time totalDelay(0);
-
 NS_LOG_COMPONENT_DEFINE ("DcfManager");
 
 /****************************************************************
@@ -41,7 +43,9 @@ NS_LOG_COMPONENT_DEFINE ("DcfManager");
  ****************************************************************/
 
 DcfState::DcfState ()
-  : m_backoffSlots (0),
+  : m_manager (0),
+    m_index (0),
+    m_backoffSlots (0),
     m_backoffStart (Seconds (0.0)),
     m_cwMin (0),
     m_cwMax (0),
@@ -57,6 +61,15 @@ DcfState::~DcfState ()
 void
 DcfState::SetAifsn (uint32_t aifsn)
 {
+  if (m_manager != 0)
+    {
+      m_manager->RecordCall (DcfManager::CALL_SET_AIFSN, m_index, aifsn);
+      m_manager->m_aifsns[m_index] = aifsn;
+      //the AIFS is part of the backoff end of the indexed entries
+      m_manager->m_backoffIndexDirty = true;
+      m_manager->m_fastGrantState = 0;
+      return;
+    }
   m_aifsn = aifsn;
 }
 
@@ -85,6 +98,10 @@ DcfState::SetCwMax (uint32_t maxCw)
 uint32_t
 DcfState::GetAifsn (void) const
 {
+  if (m_manager != 0)
+    {
+      return m_manager->m_aifsns[m_index];
+    }
   return m_aifsn;
 }
 
@@ -108,26 +125,57 @@ DcfState::ResetCw (void)
 
 void
 DcfState::UpdateFailedCw (void)
+{
+  m_cw = GetFailedCw (m_cw, m_cwMax);
+}
+
+uint32_t
+DcfState::GetFailedCw (uint32_t cw, uint32_t cwMax)
 {
   //see 802.11-2012, section 9.19.2.5 
   //For linear backoff, uncomment the line below and comment out the xponential backoff.
-  m_cw = std::min ( m_cw + 31, m_cwMax);
- //m_cw = std::min ( 2 * (m_cw + 1) - 1, m_cwMax);
+  return std::min ( cw + 31, cwMax);
+ //return std::min ( 2 * (cw + 1) - 1, cwMax);
 }
 
 void
 DcfState::UpdateBackoffSlotsNow (uint32_t nSlots, Time backoffUpdateBound)
 {
+  if (m_manager != 0)
+    {
+      if (nSlots > 0 && m_manager->m_backoffSlots[m_index] == nSlots)
+        {
+          m_manager->m_nActiveBackoffs--;
+        }
+      m_manager->m_backoffSlots[m_index] -= nSlots;
+      m_manager->m_backoffStarts[m_index] = backoffUpdateBound.GetTimeStep ();
+      if (nSlots > 0)
+        {
+          m_manager->RecordTrace (DcfManager::TRACE_BACKOFF_UPDATE, m_index, nSlots);
+        }
+      return;
+    }
   m_backoffSlots -= nSlots;
   m_backoffStart = backoffUpdateBound;
-  MY_DEBUG ("update slots=" << nSlots << " slots, backoff=" << m_backoffSlots);
 }
 
 void
 DcfState::StartBackoffNow (uint32_t nSlots)
 {
-  NS_ASSERT (m_backoffSlots == 0);
-  MY_DEBUG ("start backoff=" << nSlots << " slots");
+  NS_ASSERT (GetBackoffSlots () == 0);
+  if (m_manager != 0)
+    {
+      m_manager->RecordTrace (DcfManager::TRACE_BACKOFF_START, m_index, nSlots);
+      m_manager->RecordCall (DcfManager::CALL_BACKOFF_START, m_index, nSlots);
+      m_manager->m_stateStatistics[m_index].backoffSlots[DcfManager::GetBackoffBin (nSlots)]++;
+      if (nSlots > 0)
+        {
+          m_manager->m_nActiveBackoffs++;
+        }
+      m_manager->m_backoffSlots[m_index] = nSlots;
+      m_manager->m_backoffStarts[m_index] = Simulator::Now ().GetTimeStep ();
+      return;
+    }
   m_backoffSlots = nSlots;
   m_backoffStart = Simulator::Now ();
 }
@@ -141,12 +189,20 @@ DcfState::GetCw (void) const
 uint32_t
 DcfState::GetBackoffSlots (void) const
 {
+  if (m_manager != 0)
+    {
+      return m_manager->m_backoffSlots[m_index];
+    }
   return m_backoffSlots;
 }
 
 Time
 DcfState::GetBackoffStart (void) const
 {
+  if (m_manager != 0)
+    {
+      return TimeStep (m_manager->m_backoffStarts[m_index]);
+    }
   return m_backoffStart;
 }
 
@@ -166,40 +222,182 @@ DcfState::NotifyAccessGranted (void)
 {
   NS_ASSERT (m_accessRequested);
   m_accessRequested = false;
+  if (m_manager != 0)
+    {
+      m_manager->RecordCall (DcfManager::CALL_NOTIFY_ACCESS_GRANTED, m_index, 0);
+    }
   DoNotifyAccessGranted ();
 }
 
 void
 DcfState::NotifyCollision (void)
 {
+  if (m_manager != 0)
+    {
+      m_manager->RecordCall (DcfManager::CALL_NOTIFY_COLLISION, m_index, 0);
+    }
   DoNotifyCollision ();
 }
 
 void
 DcfState::NotifyInternalCollision (void)
 {
+  if (m_manager != 0)
+    {
+      m_manager->RecordCall (DcfManager::CALL_NOTIFY_INTERNAL_COLLISION, m_index, 0);
+    }
   DoNotifyInternalCollision ();
 }
 
 void
 DcfState::NotifyChannelSwitching (void)
 {
+  if (m_manager != 0)
+    {
+      m_manager->RecordCall (DcfManager::CALL_NOTIFY_CHANNEL_SWITCHING, m_index, 0);
+    }
   DoNotifyChannelSwitching ();
 }
 
 void
 DcfState::NotifySleep (void)
 {
+  if (m_manager != 0)
+    {
+      m_manager->RecordCall (DcfManager::CALL_NOTIFY_SLEEP, m_index, 0);
+    }
   DoNotifySleep ();
 }
 
 void
 DcfState::NotifyWakeUp (void)
 {
+  if (m_manager != 0)
+    {
+      m_manager->RecordCall (DcfManager::CALL_NOTIFY_WAKEUP, m_index, 0);
+    }
   DoNotifyWakeUp ();
 }
 
 
+class DcfManager::CallScope
+{
+public:
+  /**
+   * Record a call into the given DcfManager, if it is recording.
+   *
+   * \param manager the DcfManager
+   * \param type the type of the call
+   * \param index the priority index of the DcfState, or TRACE_ALL_STATES
+   * \param arg the type-dependent argument
+   */
+  CallScope (DcfManager *manager, CallRecordType type, uint32_t index, int64_t arg)
+    : m_manager (manager->m_recording != 0 ? manager : 0)
+  {
+    if (m_manager != 0)
+      {
+        m_manager->RecordCall (type, index, arg);
+        m_manager->m_recordDepth++;
+      }
+  }
+  ~CallScope ()
+  {
+    if (m_manager != 0)
+      {
+        m_manager->m_recordDepth--;
+      }
+  }
+
+private:
+  DcfManager *m_manager; //!< the recording DcfManager, 0 if not recording
+};
+
+
+class DcfManager::AccessTimeoutEvent : public EventImpl
+{
+public:
+  /**
+   * \param manager the DcfManager whose AccessTimeout is called
+   */
+  AccessTimeoutEvent (DcfManager *manager)
+    : m_manager (manager)
+  {
+  }
+  /**
+   * Take the memory of an event from the free list, if it is not empty.
+   * The first event allocated from the heap schedules ReleaseFreeList
+   * at Simulator::Destroy.
+   *
+   * \param size the size of an AccessTimeoutEvent
+   * \return the memory of the event
+   */
+  static void * operator new (std::size_t size)
+  {
+    NS_ASSERT (size == sizeof (AccessTimeoutEvent));
+    void *memory = m_free;
+    if (memory == 0)
+      {
+        if (!m_releaseScheduled)
+          {
+            Simulator::ScheduleDestroy (&AccessTimeoutEvent::ReleaseFreeList);
+            m_releaseScheduled = true;
+          }
+        return ::operator new (size);
+      }
+    m_free = *static_cast<void **> (memory);
+    return memory;
+  }
+  /**
+   * Put the memory of an event in the free list, which only holds as many
+   * events as were alive at once, i.e., about two per DcfManager. Once the
+   * list was released, the events still deleted by Simulator::Destroy go
+   * back to the heap.
+   *
+   * \param memory the memory of the event
+   */
+  static void operator delete (void *memory)
+  {
+    if (!m_releaseScheduled)
+      {
+        ::operator delete (memory);
+        return;
+      }
+    *static_cast<void **> (memory) = m_free;
+    m_free = memory;
+  }
+  /**
+   * Give the memory of the free list back to the heap.
+   */
+  static void ReleaseFreeList (void)
+  {
+    while (m_free != 0)
+      {
+        void *memory = m_free;
+        m_free = *static_cast<void **> (memory);
+        ::operator delete (memory);
+      }
+    m_releaseScheduled = false;
+  }
+
+private:
+  virtual void Notify (void)
+  {
+    m_manager->AccessTimeout ();
+  }
+
+  DcfManager *m_manager; //!< the DcfManager to call
+  /*
+   * The free list is shared by all the DcfManagers and is not locked: like
+   * the default simulator, it must only be used from a single thread.
+   */
+  static void *m_free;             //!< first block of the free list, which links the blocks through their first word
+  static bool m_releaseScheduled;  //!< whether ReleaseFreeList is scheduled at Simulator::Destroy
+};
+
+void *DcfManager::AccessTimeoutEvent::m_free = 0;
+bool DcfManager::AccessTimeoutEvent::m_releaseScheduled = false;
+
+
 /**
  * Listener for NAV events. Forwards to DcfManager
  */
@@ -305,14 +503,25 @@ private:
 
 
 /****************************************************************
- *      Implement the DCF manager of all DCF state holders
+ *      Implement the medium state shared by DCF managers
  ****************************************************************/
 
-DcfManager::DcfManager ()
-  : m_lastAckTimeoutEnd (MicroSeconds (0)),
-    m_lastCtsTimeoutEnd (MicroSeconds (0)),
-    m_lastNavStart (MicroSeconds (0)),
-    m_lastNavDuration (MicroSeconds (0)),
+/**
+ * \return the DcfMediumState of each medium group
+ */
+static std::map<uint32_t, DcfMediumState *> &
+GetMediumGroups (void)
+{
+  static std::map<uint32_t, DcfMediumState *> groups;
+  return groups;
+}
+
+const uint32_t DcfMediumState::NO_MEDIUM_INDEX;
+
+DcfMediumState::DcfMediumState (uint32_t group)
+  : m_group (group),
+    m_feeder (0),
+    m_eifsNoDifs (MicroSeconds (0)),
     m_lastRxStart (MicroSeconds (0)),
     m_lastRxDuration (MicroSeconds (0)),
     m_lastRxReceivedOk (true),
@@ -324,393 +533,1541 @@ DcfManager::DcfManager ()
     m_lastSwitchingStart (MicroSeconds (0)),
     m_lastSwitchingDuration (MicroSeconds (0)),
     m_rxing (false),
-    m_sleeping (false),
-    m_slotTimeUs (0),
-    m_sifs (Seconds (0.0)),
-    m_phyListener (0),
-    m_lowListener (0)
+    m_accessStart (MicroSeconds (0)),
+    m_accessStartEifs (false),
+    m_accessStartWithoutRx (MicroSeconds (0))
 {
-  NS_LOG_FUNCTION (this);
+  NS_LOG_FUNCTION (this << group);
 }
 
-DcfManager::~DcfManager ()
+DcfMediumState::~DcfMediumState ()
 {
-  delete m_phyListener;
-  delete m_lowListener;
-  m_phyListener = 0;
-  m_lowListener = 0;
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (m_managers.empty ());
+  //the transmission was only heard by members which are gone
+  Simulator::Cancel (m_txStartEvent);
+  //unless the groups were forgotten and the id reused since
+  std::map<uint32_t, DcfMediumState *>::iterator i = GetMediumGroups ().find (m_group);
+  if (m_group != 0 && i != GetMediumGroups ().end () && i->second == this)
+    {
+      GetMediumGroups ().erase (i);
+    }
 }
 
-void
-DcfManager::SetupPhyListener (Ptr<WifiPhy> phy)
+Ptr<DcfMediumState>
+DcfMediumState::GetGroup (uint32_t group)
 {
-  NS_LOG_FUNCTION (this << phy);
-  if (m_phyListener != 0)
+  NS_ASSERT (group != 0);
+  std::map<uint32_t, DcfMediumState *>::const_iterator i = GetMediumGroups ().find (group);
+  if (i != GetMediumGroups ().end ())
     {
-      delete m_phyListener;
+      return i->second;
     }
-  m_phyListener = new PhyListener (this);
-  phy->RegisterListener (m_phyListener);
+  if (GetMediumGroups ().empty ())
+    {
+      Simulator::ScheduleDestroy (&DcfMediumState::ForgetGroups);
+    }
+  Ptr<DcfMediumState> medium = Create<DcfMediumState> (group);
+  GetMediumGroups ()[group] = PeekPointer (medium);
+  return medium;
 }
 
 void
-DcfManager::RemovePhyListener (Ptr<WifiPhy> phy)
+DcfMediumState::ForgetGroups (void)
 {
-  NS_LOG_FUNCTION (this << phy);
-  if (m_phyListener != 0)
-    {
-      phy->UnregisterListener (m_phyListener);
-      delete m_phyListener;
-      m_phyListener = 0;
-    }
+  NS_LOG_FUNCTION_NOARGS ();
+  GetMediumGroups ().clear ();
 }
 
-void
-DcfManager::SetupLowListener (Ptr<MacLow> low)
+uint32_t
+DcfMediumState::GetGroupId (void) const
 {
-  NS_LOG_FUNCTION (this << low);
-  if (m_lowListener != 0)
-    {
-      delete m_lowListener;
-    }
-  m_lowListener = new LowDcfListener (this);
-  low->RegisterDcfListener (m_lowListener);
+  return m_group;
 }
 
 void
-DcfManager::SetSlot (Time slotTime)
+DcfMediumState::Join (DcfManager *manager)
 {
-  NS_LOG_FUNCTION (this << slotTime);
-  m_slotTimeUs = slotTime.GetMicroSeconds ();
+  NS_LOG_FUNCTION (this << manager);
+  NS_ASSERT (manager->m_mediumIndex == NO_MEDIUM_INDEX);
+  manager->m_mediumIndex = m_managers.size ();
+  m_managers.push_back (manager);
 }
 
 void
-DcfManager::SetSifs (Time sifs)
+DcfMediumState::Leave (DcfManager *manager)
 {
-  NS_LOG_FUNCTION (this << sifs);
-  m_sifs = sifs;
+  NS_LOG_FUNCTION (this << manager);
+  ReleaseFeeder (manager);
+  uint32_t index = manager->m_mediumIndex;
+  if (index == NO_MEDIUM_INDEX)
+    {
+      return;
+    }
+  NS_ASSERT (m_managers[index] == manager);
+  //the order of the members does not matter: fill the hole with the last one
+  m_managers[index] = m_managers.back ();
+  m_managers[index]->m_mediumIndex = index;
+  m_managers.pop_back ();
+  manager->m_mediumIndex = NO_MEDIUM_INDEX;
+}
+
+bool
+DcfMediumState::AcquireFeeder (DcfManager *manager)
+{
+  if (m_group != 0 && manager->m_sleeping)
+    {
+      //the PHY of a sleeping DcfManager does not feed its group
+      return false;
+    }
+  if (m_feeder == 0)
+    {
+      m_feeder = manager;
+    }
+  return IsFeeder (manager);
 }
 
 void
-DcfManager::SetEifsNoDifs (Time eifsNoDifs)
+DcfMediumState::ReleaseFeeder (DcfManager *manager)
 {
-  NS_LOG_FUNCTION (this << eifsNoDifs);
-  m_eifsNoDifs = eifsNoDifs;
+  NS_LOG_FUNCTION (this << manager);
+  if (m_feeder == manager)
+    {
+      m_feeder = 0;
+    }
 }
 
-Time
-DcfManager::GetEifsNoDifs () const
+bool
+DcfMediumState::IsFeeder (const DcfManager *manager) const
 {
-  NS_LOG_FUNCTION (this);
-  return m_eifsNoDifs;
+  //a DcfManager which does not share its medium state always feeds it
+  return m_group == 0 || m_feeder == manager;
 }
 
 void
-DcfManager::Add (DcfState *dcf)
+DcfMediumState::SetEifsNoDifs (Time eifsNoDifs)
 {
-  NS_LOG_FUNCTION (this << dcf);
-  m_states.push_back (dcf);
+  m_eifsNoDifs = eifsNoDifs;
+  UpdateAccessStart ();
 }
 
 Time
-DcfManager::MostRecent (Time a, Time b) const
+DcfMediumState::GetAccessStart (void) const
 {
-  NS_LOG_FUNCTION (this << a << b);
-  return Max (a, b);
+  return m_accessStart;
 }
 
-Time
-DcfManager::MostRecent (Time a, Time b, Time c) const
+bool
+DcfMediumState::IsRxing (void) const
 {
-  NS_LOG_FUNCTION (this << a << b << c);
-  Time retval;
-  retval = Max (a, b);
-  retval = Max (retval, c);
-  return retval;
+  return m_rxing;
+}
+
+bool
+DcfMediumState::IsAccessStartEifs (void) const
+{
+  return m_accessStartEifs;
 }
 
 Time
-DcfManager::MostRecent (Time a, Time b, Time c, Time d) const
+DcfMediumState::GetAccessStartWithoutRx (void) const
 {
-  NS_LOG_FUNCTION (this << a << b << c << d);
-  Time e = Max (a, b);
-  Time f = Max (c, d);
-  Time retval = Max (e, f);
-  return retval;
+  return m_accessStartWithoutRx;
 }
 
 Time
-DcfManager::MostRecent (Time a, Time b, Time c, Time d, Time e, Time f) const
+DcfMediumState::GetRxStart (void) const
 {
-  NS_LOG_FUNCTION (this << a << b << c << d << e << f);
-  Time g = Max (a, b);
-  Time h = Max (c, d);
-  Time i = Max (e, f);
-  Time k = Max (g, h);
-  Time retval = Max (k, i);
-  return retval;
+  return m_lastRxStart;
 }
 
 Time
-DcfManager::MostRecent (Time a, Time b, Time c, Time d, Time e, Time f, Time g) const
+DcfMediumState::GetTxEnd (void) const
 {
-  NS_LOG_FUNCTION (this << a << b << c << d << e << f << g);
-  Time h = Max (a, b);
-  Time i = Max (c, d);
-  Time j = Max (e, f);
-  Time k = Max (h, i);
-  Time l = Max (j, g);
-  Time retval = Max (k, l);
-  return retval;
+  return m_lastTxStart + m_lastTxDuration;
 }
 
-bool
-DcfManager::IsBusy (void) const
+void
+DcfMediumState::UpdateAccessStart (void)
 {
-  NS_LOG_FUNCTION (this);
-  // PHY busy
-  if (m_rxing)
-    {
-      return true;
-    }
-  Time lastTxEnd = m_lastTxStart + m_lastTxDuration;
-  if (lastTxEnd > Simulator::Now ())
+  Time rxEnd;
+  if (!m_rxing)
     {
-      return true;
+      rxEnd = m_lastRxEnd;
+      if (!m_lastRxReceivedOk)
+        {
+          rxEnd += m_eifsNoDifs;
+        }
     }
-  // NAV busy
-  Time lastNavEnd = m_lastNavStart + m_lastNavDuration;
-  if (lastNavEnd > Simulator::Now ())
+  else
     {
-      return true;
+      rxEnd = m_lastRxStart + m_lastRxDuration;
     }
-  return false;
+  Time busyEnd = m_lastBusyStart + m_lastBusyDuration;
+  Time txEnd = m_lastTxStart + m_lastTxDuration;
+  Time switchingEnd = m_lastSwitchingStart + m_lastSwitchingDuration;
+  Time otherEnd = Max (busyEnd, Max (txEnd, switchingEnd));
+  m_accessStart = Max (rxEnd, otherEnd);
+  m_accessStartEifs = !m_rxing && !m_lastRxReceivedOk && rxEnd > otherEnd && m_eifsNoDifs.IsStrictlyPositive ();
+  m_accessStartWithoutRx = otherEnd;
 }
 
 void
-DcfManager::RequestAccess (DcfState *state)
+DcfMediumState::UpdateBackoffs (void)
 {
-  NS_LOG_FUNCTION (this << state);
-  //Deny access if in sleep mode
-  if (m_sleeping)
-    {
-      return;
-    }
-  UpdateBackoff ();
-  NS_ASSERT (!state->IsAccessRequested ());
-  state->NotifyAccessRequested ();
-  /**
-   * If there is a collision, generate a backoff
-   * by notifying the collision to the user.
-   */
-  if (state->GetBackoffSlots () == 0
-      && IsBusy ())
+  for (std::vector<DcfManager *>::const_iterator i = m_managers.begin (); i != m_managers.end (); i++)
     {
-      MY_DEBUG ("medium is busy: collision");
-      /* someone else has accessed the medium.
-       * generate a backoff.
-       */
-      state->NotifyCollision ();
+      (*i)->UpdateBackoff ();
     }
-  DoGrantAccess ();
-  DoRestartAccessTimeoutIfNeeded ();
 }
 
 void
-DcfManager::DoGrantAccess (void)
+DcfMediumState::UpdateAccessGrantStarts (void)
 {
-  NS_LOG_FUNCTION (this);
-  uint32_t k = 0;
-  for (States::const_iterator i = m_states.begin (); i != m_states.end (); k++)
+  for (std::vector<DcfManager *>::const_iterator i = m_managers.begin (); i != m_managers.end (); i++)
     {
-      DcfState *state = *i;
-      if (state->IsAccessRequested ()
-          && GetBackoffEndFor (state) <= Simulator::Now () )
-        {
-          /**
-           * This is the first dcf we find with an expired backoff and which
-           * needs access to the medium. i.e., it has data to send.
-           */
-          MY_DEBUG ("dcf " << k << " needs access. backoff expired. access granted. slots=" << state->GetBackoffSlots ());
-          i++; //go to the next item in the list.
-          k++;
-          std::vector<DcfState *> internalCollisionStates;
-          for (States::const_iterator j = i; j != m_states.end (); j++, k++)
-            {
-              DcfState *otherState = *j;
-              if (otherState->IsAccessRequested ()
-                  && GetBackoffEndFor (otherState) <= Simulator::Now ())
-                {
-                  MY_DEBUG ("dcf " << k << " needs access. backoff expired. internal collision. slots=" <<
-                            otherState->GetBackoffSlots ());
-                  /**
-                   * all other dcfs with a lower priority whose backoff
-                   * has expired and which needed access to the medium
-                   * must be notified that we did get an internal collision.
-                   */
-                  internalCollisionStates.push_back (otherState);
-                }
-            }
-
-          /**
-           * Now, we notify all of these changes in one go. It is necessary to
-           * perform first the calculations of which states are colliding and then
-           * only apply the changes because applying the changes through notification
-           * could change the global state of the manager, and, thus, could change
-           * the result of the calculations.
-           */
-          state->NotifyAccessGranted ();
-          for (std::vector<DcfState *>::const_iterator k = internalCollisionStates.begin ();
-               k != internalCollisionStates.end (); k++)
-            {
-              (*k)->NotifyInternalCollision ();
-            }
-          break;
-        }
-      i++;
+      (*i)->UpdateAccessGrantStart ();
     }
 }
 
 void
-DcfManager::AccessTimeout (void)
+DcfMediumState::NotifyRxStartNow (Time duration)
 {
   NS_LOG_FUNCTION (this);
-  UpdateBackoff ();
-  DoGrantAccess ();
-  DoRestartAccessTimeoutIfNeeded ();
+  UpdateBackoffs ();
+  m_lastRxStart = Simulator::Now ();
+  m_lastRxDuration = duration;
+  m_rxing = true;
+  UpdateAccessStart ();
+  UpdateAccessGrantStarts ();
 }
 
-Time
-DcfManager::GetAccessGrantStart (void) const
+void
+DcfMediumState::NotifyRxEndOkNow (void)
 {
   NS_LOG_FUNCTION (this);
-  Time rxAccessStart;
-  if (!m_rxing)
+  m_lastRxEnd = Simulator::Now ();
+  m_lastRxReceivedOk = true;
+  m_rxing = false;
+  UpdateAccessStart ();
+  UpdateAccessGrantStarts ();
+}
+
+void
+DcfMediumState::NotifyRxEndErrorNow (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_lastRxEnd = Simulator::Now ();
+  m_lastRxReceivedOk = false;
+  m_rxing = false;
+  UpdateAccessStart ();
+  UpdateAccessGrantStarts ();
+}
+
+void
+DcfMediumState::NotifyTxStartNow (Time duration)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_group != 0)
+    {
+      /**
+       * The other members would only hear the feeder after the
+       * propagation delay: let the access timeouts of this time slot
+       * expire first. The feeder already defers to its own transmission.
+       */
+      m_txStartEvent = Simulator::ScheduleNow (&DcfMediumState::DoNotifyTxStart, this, duration);
+      return;
+    }
+  DoNotifyTxStart (duration);
+}
+
+void
+DcfMediumState::DoNotifyTxStart (Time duration)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_rxing)
+    {
+      //this may be caused only if PHY has started to receive a packet
+      //inside SIFS, so, we check that lastRxStart was maximum a SIFS ago
+      //(the members of a group share the SIFS of the feeding PHY)
+      NS_ASSERT (m_managers.empty () || Simulator::Now () - m_lastRxStart <= m_managers.front ()->m_sifs);
+      m_lastRxEnd = Simulator::Now ();
+      m_lastRxDuration = m_lastRxEnd - m_lastRxStart;
+      m_lastRxReceivedOk = true;
+      m_rxing = false;
+      UpdateAccessStart ();
+      UpdateAccessGrantStarts ();
+    }
+  UpdateBackoffs ();
+  m_lastTxStart = Simulator::Now ();
+  m_lastTxDuration = duration;
+  UpdateAccessStart ();
+  UpdateAccessGrantStarts ();
+}
+
+void
+DcfMediumState::NotifyMaybeCcaBusyStartNow (Time duration)
+{
+  NS_LOG_FUNCTION (this);
+  UpdateBackoffs ();
+  m_lastBusyStart = Simulator::Now ();
+  m_lastBusyDuration = duration;
+  UpdateAccessStart ();
+  UpdateAccessGrantStarts ();
+}
+
+void
+DcfMediumState::NotifySwitchingStartNow (Time duration)
+{
+  NS_LOG_FUNCTION (this);
+  Time now = Simulator::Now ();
+  NS_ASSERT (m_lastTxStart + m_lastTxDuration <= now);
+  NS_ASSERT (m_lastSwitchingStart + m_lastSwitchingDuration <= now);
+
+  if (m_rxing)
+    {
+      //channel switching during packet reception
+      m_lastRxEnd = Simulator::Now ();
+      m_lastRxDuration = m_lastRxEnd - m_lastRxStart;
+      m_lastRxReceivedOk = true;
+      m_rxing = false;
+    }
+  if (m_lastBusyStart + m_lastBusyDuration > now)
+    {
+      m_lastBusyDuration = now - m_lastBusyStart;
+    }
+  UpdateAccessStart ();
+  for (std::vector<DcfManager *>::const_iterator i = m_managers.begin (); i != m_managers.end (); i++)
+    {
+      (*i)->DoNotifySwitchingStart (duration);
+    }
+
+  m_lastSwitchingStart = Simulator::Now ();
+  m_lastSwitchingDuration = duration;
+  UpdateAccessStart ();
+  UpdateAccessGrantStarts ();
+}
+
+/****************************************************************
+ *      Implement the DCF manager of all DCF state holders
+ ****************************************************************/
+
+NS_OBJECT_ENSURE_REGISTERED (DcfManager);
+
+const uint32_t DcfManager::BACKOFF_DELAY_BINS;
+const uint32_t DcfManager::DEFERRAL_CAUSES;
+const uint32_t DcfManager::TRACE_ALL_STATES;
+const uint32_t DcfManager::TRACE_RING_MAGIC;
+const uint32_t DcfManager::TRACE_RING_VERSION;
+const uint32_t DcfManager::CALL_RECORDING_MAGIC;
+const uint32_t DcfManager::CALL_RECORDING_VERSION;
+
+TypeId
+DcfManager::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DcfManager")
+    .SetParent<Object> ()
+    .SetGroupName ("Wifi")
+    .AddAttribute ("Grants",
+                   "The number of times access was granted to one of the DcfStates.",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&DcfManager::GetGrants),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("Collisions",
+                   "The number of times access was requested on a busy medium with no backoff left.",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&DcfManager::GetCollisions),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("InternalCollisions",
+                   "The number of internal collisions between the DcfStates of this manager.",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&DcfManager::GetInternalCollisions),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("TotalBackoffDelay",
+                   "The sum of the expected backoff delays of all the access timeouts.",
+                   TypeId::ATTR_GET,
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&DcfManager::GetTotalBackoffDelay),
+                   MakeTimeChecker ())
+    .AddAttribute ("TraceRingSize",
+                   "The number of records kept in the binary event ring (0 disables it).",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&DcfManager::SetTraceRingSize,
+                                         &DcfManager::GetTraceRingSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("RecordFilePrefix",
+                   "If not empty, record all the calls into this DcfManager to <prefix>-<n>.dcfr.",
+                   StringValue (""),
+                   MakeStringAccessor (&DcfManager::SetRecordFilePrefix,
+                                       &DcfManager::GetRecordFilePrefix),
+                   MakeStringChecker ())
+    .AddAttribute ("MediumGroup",
+                   "If not 0, share the rx, tx, CCA busy and channel switching state with the "
+                   "other DcfManagers of this group, which must all hear each other.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&DcfManager::SetMediumGroup,
+                                         &DcfManager::GetMediumGroup),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("SampleInterval",
+                   "The interval between two samples of the StateStatistics and Deferrals "
+                   "trace sources, 0 to disable them.",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&DcfManager::SetSampleInterval,
+                                     &DcfManager::GetSampleInterval),
+                   MakeTimeChecker ())
+    .AddTraceSource ("AccessGranted",
+                     "Access to the medium was granted to a DcfState.",
+                     MakeTraceSourceAccessor (&DcfManager::m_accessGrantedTrace),
+                     "ns3::DcfManager::StateTracedCallback")
+    .AddTraceSource ("Collision",
+                     "A DcfState requested access while the medium was busy.",
+                     MakeTraceSourceAccessor (&DcfManager::m_collisionTrace),
+                     "ns3::DcfManager::StateTracedCallback")
+    .AddTraceSource ("InternalCollision",
+                     "A DcfState lost an internal collision to a higher priority DcfState.",
+                     MakeTraceSourceAccessor (&DcfManager::m_internalCollisionTrace),
+                     "ns3::DcfManager::StateTracedCallback")
+    .AddTraceSource ("ExpectedBackoffDelay",
+                     "The expected backoff delay computed when the access timeout is restarted.",
+                     MakeTraceSourceAccessor (&DcfManager::m_backoffDelayTrace),
+                     "ns3::Time::TracedCallback")
+    .AddTraceSource ("StateStatistics",
+                     "The contention statistics of a DcfState, sampled every SampleInterval.",
+                     MakeTraceSourceAccessor (&DcfManager::m_stateStatisticsTrace),
+                     "ns3::DcfManager::StateStatisticsTracedCallback")
+    .AddTraceSource ("Deferrals",
+                     "The time deferred for each cause, sampled every SampleInterval.",
+                     MakeTraceSourceAccessor (&DcfManager::m_deferralsTrace),
+                     "ns3::DcfManager::DeferralTracedCallback")
+    .AddTraceSource ("AccessTimeout",
+                     "The access timeout expired.",
+                     MakeTraceSourceAccessor (&DcfManager::m_accessTimeoutTrace),
+                     "ns3::TracedCallback::Void")
+  ;
+  return tid;
+}
+
+TypeId
+DcfManager::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+/**
+ * \return the DcfManager which listens to each PHY
+ */
+static std::map<const WifiPhy *, DcfManager *> &
+GetPhyManagers (void)
+{
+  static std::map<const WifiPhy *, DcfManager *> managers;
+  return managers;
+}
+
+DcfManager *
+DcfManager::GetDcfManager (Ptr<WifiPhy> phy)
+{
+  std::map<const WifiPhy *, DcfManager *>::const_iterator i = GetPhyManagers ().find (PeekPointer (phy));
+  return i != GetPhyManagers ().end () ? i->second : 0;
+}
+
+DcfManager::DcfManager ()
+  : m_nActiveBackoffs (0),
+    m_lastAckTimeoutEnd (MicroSeconds (0)),
+    m_lastCtsTimeoutEnd (MicroSeconds (0)),
+    m_lastNavStart (MicroSeconds (0)),
+    m_lastNavDuration (MicroSeconds (0)),
+    m_medium (Create<DcfMediumState> (0)),
+    m_mediumIndex (DcfMediumState::NO_MEDIUM_INDEX),
+    m_ownTxStart (MicroSeconds (0)),
+    m_ownTxEnd (MicroSeconds (0)),
+    m_sleeping (false),
+    m_accessGrantStart (MicroSeconds (0)),
+    m_backoffIndexDirty (false),
+    m_nAccessRequested (0),
+    m_fastGrantState (0),
+    m_fastGrantEnd (Seconds (0)),
+    m_slot (0),
+    m_sifs (Seconds (0.0)),
+    m_phyListener (0),
+    m_lowListener (0),
+    m_deferralCheckpoint (Seconds (0)),
+    m_deferralEnd (Seconds (0)),
+    m_deferralCause (DEFERRAL_BUSY),
+    m_sampleInterval (Seconds (0)),
+    m_sampleTimer (Timer::CANCEL_ON_DESTROY),
+    m_traceRingHead (0),
+    m_nTraceRecords (0),
+    m_recording (0),
+    m_recordDepth (0)
+{
+  NS_LOG_FUNCTION (this);
+  m_sampleTimer.SetFunction (&DcfManager::Sample, this);
+  m_medium->Join (this);
+  ResetStatistics ();
+}
+
+DcfManager::~DcfManager ()
+{
+  Simulator::Remove (m_accessTimeout);
+  for (std::map<const WifiPhy *, DcfManager *>::iterator i = GetPhyManagers ().begin (); i != GetPhyManagers ().end (); )
+    {
+      if (i->second == this)
+        {
+          GetPhyManagers ().erase (i++);
+        }
+      else
+        {
+          i++;
+        }
+    }
+  m_medium->Leave (this);
+  delete m_phyListener;
+  delete m_lowListener;
+  delete m_recording;
+  m_phyListener = 0;
+  m_lowListener = 0;
+  m_recording = 0;
+}
+
+void
+DcfManager::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  Simulator::Remove (m_accessTimeout);
+  m_sampleTimer.Cancel ();
+  m_medium->Leave (this);
+  //drop our reference to the group, whose last member destroys it
+  m_medium = Create<DcfMediumState> (0);
+  Object::DoDispose ();
+}
+
+void
+DcfManager::SetupPhyListener (Ptr<WifiPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  if (m_phyListener != 0)
+    {
+      delete m_phyListener;
+    }
+  m_phyListener = new PhyListener (this);
+  phy->RegisterListener (m_phyListener);
+  GetPhyManagers ()[PeekPointer (phy)] = this;
+  if (!m_medium->AcquireFeeder (this))
+    {
+      NS_LOG_DEBUG ("medium group " << m_medium->GetGroupId () << " is fed by another PHY");
+    }
+}
+
+void
+DcfManager::RemovePhyListener (Ptr<WifiPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  if (m_phyListener != 0)
+    {
+      phy->UnregisterListener (m_phyListener);
+      delete m_phyListener;
+      m_phyListener = 0;
+    }
+  if (GetDcfManager (phy) == this)
+    {
+      GetPhyManagers ().erase (PeekPointer (phy));
+    }
+  m_medium->ReleaseFeeder (this);
+}
+
+void
+DcfManager::SetMediumGroup (uint32_t group)
+{
+  NS_LOG_FUNCTION (this << group);
+  if (group == m_medium->GetGroupId ())
+    {
+      return;
+    }
+  m_medium->Leave (this);
+  if (group == 0)
+    {
+      m_medium = Create<DcfMediumState> (0);
+    }
+  else
+    {
+      m_medium = DcfMediumState::GetGroup (group);
+    }
+  if (!m_sleeping)
+    {
+      m_medium->Join (this);
+    }
+  m_medium->SetEifsNoDifs (m_eifsNoDifs);
+  if (m_phyListener != 0)
+    {
+      m_medium->AcquireFeeder (this);
+    }
+  UpdateAccessGrantStart ();
+}
+
+uint32_t
+DcfManager::GetMediumGroup (void) const
+{
+  return m_medium->GetGroupId ();
+}
+
+void
+DcfManager::SetupLowListener (Ptr<MacLow> low)
+{
+  NS_LOG_FUNCTION (this << low);
+  if (m_lowListener != 0)
+    {
+      delete m_lowListener;
+    }
+  m_lowListener = new LowDcfListener (this);
+  low->RegisterDcfListener (m_lowListener);
+}
+
+void
+DcfManager::SetSlot (Time slotTime)
+{
+  NS_LOG_FUNCTION (this << slotTime);
+  RecordCall (CALL_SET_SLOT, TRACE_ALL_STATES, slotTime.GetTimeStep ());
+  m_slot = slotTime.GetTimeStep ();
+  m_backoffIndexDirty = true;
+  m_fastGrantState = 0;
+}
+
+void
+DcfManager::SetSifs (Time sifs)
+{
+  NS_LOG_FUNCTION (this << sifs);
+  RecordCall (CALL_SET_SIFS, TRACE_ALL_STATES, sifs.GetTimeStep ());
+  m_sifs = sifs;
+  UpdateAccessGrantStart ();
+}
+
+void
+DcfManager::SetEifsNoDifs (Time eifsNoDifs)
+{
+  NS_LOG_FUNCTION (this << eifsNoDifs);
+  RecordCall (CALL_SET_EIFS_NO_DIFS, TRACE_ALL_STATES, eifsNoDifs.GetTimeStep ());
+  m_eifsNoDifs = eifsNoDifs;
+  m_medium->SetEifsNoDifs (eifsNoDifs);
+  UpdateAccessGrantStart ();
+}
+
+Time
+DcfManager::GetEifsNoDifs () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_eifsNoDifs;
+}
+
+void
+DcfManager::Add (DcfState *dcf)
+{
+  NS_LOG_FUNCTION (this << dcf);
+  NS_ASSERT (dcf->m_manager == 0);
+  dcf->m_index = m_states.size ();
+  RecordCall (CALL_ADD, dcf->m_index, GetAddRecordArg (dcf->m_aifsn, dcf->IsEdca (), dcf->m_backoffSlots));
+  m_states.push_back (dcf);
+  m_backoffIndexVersions.push_back (0);
+  //from now on, the backoff fields of the DcfState live in our arrays
+  m_backoffSlots.push_back (dcf->m_backoffSlots);
+  m_backoffStarts.push_back (dcf->m_backoffStart.GetTimeStep ());
+  m_aifsns.push_back (dcf->m_aifsn);
+  m_edcaSlots.push_back (dcf->IsEdca () ? 1 : 0);
+  m_expiredStates.reserve (m_states.size ());
+  StateStatistics stats = StateStatistics ();
+  m_stateStatistics.push_back (stats);
+  if (dcf->m_backoffSlots > 0)
+    {
+      m_nActiveBackoffs++;
+    }
+  dcf->m_manager = this;
+}
+
+uint64_t
+DcfManager::GetGrants (void) const
+{
+  return m_nGrants;
+}
+
+uint64_t
+DcfManager::GetCollisions (void) const
+{
+  return m_nCollisions;
+}
+
+uint64_t
+DcfManager::GetInternalCollisions (void) const
+{
+  return m_nInternalCollisions;
+}
+
+Time
+DcfManager::GetTotalBackoffDelay (void) const
+{
+  return m_totalBackoffDelay;
+}
+
+uint64_t
+DcfManager::GetBackoffDelayCount (uint32_t bin) const
+{
+  NS_ASSERT (bin < BACKOFF_DELAY_BINS);
+  return m_backoffDelayHistogram[bin];
+}
+
+void
+DcfManager::ResetStatistics (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_nGrants = 0;
+  m_nCollisions = 0;
+  m_nInternalCollisions = 0;
+  m_totalBackoffDelay = Seconds (0);
+  for (uint32_t i = 0; i < BACKOFF_DELAY_BINS; i++)
+    {
+      m_backoffDelayHistogram[i] = 0;
+    }
+  for (std::vector<StateStatistics>::iterator i = m_stateStatistics.begin (); i != m_stateStatistics.end (); i++)
+    {
+      *i = StateStatistics ();
+    }
+  for (uint32_t i = 0; i < DEFERRAL_CAUSES; i++)
+    {
+      m_deferrals[i] = Seconds (0);
+    }
+  m_deferralCheckpoint = Simulator::Now ();
+}
+
+const DcfManager::StateStatistics &
+DcfManager::GetStateStatistics (uint32_t index) const
+{
+  NS_ASSERT (index < m_stateStatistics.size ());
+  return m_stateStatistics[index];
+}
+
+Time
+DcfManager::GetDeferral (DeferralCause cause) const
+{
+  Time deferral = m_deferrals[cause];
+  //add the part of the current deferral which already elapsed
+  if (cause == m_deferralCause && m_deferralEnd > m_deferralCheckpoint)
+    {
+      deferral += Min (Simulator::Now (), m_deferralEnd) - m_deferralCheckpoint;
+    }
+  return deferral;
+}
+
+uint32_t
+DcfManager::GetBackoffBin (uint64_t slots)
+{
+  uint32_t bin = 0;
+  while (bin < BACKOFF_DELAY_BINS - 1 && slots + 1 >= (2ULL << bin))
+    {
+      bin++;
+    }
+  return bin;
+}
+
+void
+DcfManager::SetSampleInterval (Time interval)
+{
+  NS_LOG_FUNCTION (this << interval);
+  m_sampleInterval = interval;
+  m_sampleTimer.Cancel ();
+  if (interval.IsStrictlyPositive ())
+    {
+      m_sampleTimer.Schedule (interval);
+    }
+}
+
+Time
+DcfManager::GetSampleInterval (void) const
+{
+  return m_sampleInterval;
+}
+
+void
+DcfManager::Sample (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (uint32_t i = 0; i < m_stateStatistics.size (); i++)
+    {
+      m_stateStatisticsTrace (i, m_stateStatistics[i]);
+    }
+  m_deferralsTrace (GetDeferral (DEFERRAL_BUSY),
+                    GetDeferral (DEFERRAL_EIFS),
+                    GetDeferral (DEFERRAL_NAV),
+                    GetDeferral (DEFERRAL_TIMEOUT));
+  m_sampleTimer.Schedule (m_sampleInterval);
+}
+
+void
+DcfManager::SetTraceRingSize (uint32_t size)
+{
+  NS_LOG_FUNCTION (this << size);
+  m_traceRing.assign (size, TraceRecord ());
+  m_traceRingHead = 0;
+  m_nTraceRecords = 0;
+}
+
+uint32_t
+DcfManager::GetTraceRingSize (void) const
+{
+  return m_traceRing.size ();
+}
+
+void
+DcfManager::RecordTrace (TraceRecordType type, uint32_t index, int64_t arg)
+{
+  if (m_traceRing.empty ())
+    {
+      return;
+    }
+  TraceRecord &record = m_traceRing[m_traceRingHead];
+  record.time = Simulator::Now ().GetTimeStep ();
+  record.arg = arg;
+  record.index = index;
+  record.type = type;
+  if (++m_traceRingHead == m_traceRing.size ())
+    {
+      m_traceRingHead = 0;
+    }
+  m_nTraceRecords++;
+}
+
+void
+DcfManager::WriteTraceRing (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t capacity = m_traceRing.size ();
+  uint32_t count = std::min<uint64_t> (m_nTraceRecords, capacity);
+  TraceRingHeader header;
+  header.magic = TRACE_RING_MAGIC;
+  header.version = TRACE_RING_VERSION;
+  header.recordSize = sizeof (TraceRecord);
+  header.capacity = capacity;
+  header.nRecords = m_nTraceRecords;
+  os.write (reinterpret_cast<const char *> (&header), sizeof (header));
+  //oldest record first
+  uint32_t first = (m_traceRingHead + capacity - count) % std::max<uint32_t> (capacity, 1);
+  for (uint32_t i = 0; i < count; i++)
+    {
+      const TraceRecord &record = m_traceRing[(first + i) % capacity];
+      os.write (reinterpret_cast<const char *> (&record), sizeof (record));
+    }
+}
+
+const char *
+DcfManager::GetTraceRecordTypeName (uint32_t type)
+{
+  switch (type)
+    {
+    case TRACE_GRANT:
+      return "grant";
+    case TRACE_COLLISION:
+      return "collision";
+    case TRACE_INTERNAL_COLLISION:
+      return "internal-collision";
+    case TRACE_BACKOFF_START:
+      return "backoff-start";
+    case TRACE_BACKOFF_UPDATE:
+      return "backoff-update";
+    case TRACE_ACCESS_TIMEOUT_START:
+      return "access-timeout-start";
+    case TRACE_ACCESS_TIMEOUT:
+      return "access-timeout";
+    case TRACE_RX_START:
+      return "rx-start";
+    case TRACE_RX_END_OK:
+      return "rx-end-ok";
+    case TRACE_RX_END_ERROR:
+      return "rx-end-error";
+    case TRACE_TX_START:
+      return "tx-start";
+    case TRACE_BUSY_START:
+      return "busy-start";
+    case TRACE_SWITCHING_START:
+      return "switching-start";
+    case TRACE_NAV_START:
+      return "nav-start";
+    case TRACE_NAV_RESET:
+      return "nav-reset";
+    default:
+      return "unknown";
+    }
+}
+
+void
+DcfManager::SetRecordFilePrefix (std::string prefix)
+{
+  NS_LOG_FUNCTION (this << prefix);
+  static uint32_t nRecordings = 0;
+  delete m_recording;
+  m_recording = 0;
+  m_recordFilePrefix = prefix;
+  if (prefix.empty ())
+    {
+      return;
+    }
+  std::ostringstream filename;
+  filename << prefix << "-" << nRecordings++ << ".dcfr";
+  std::ofstream *os = new std::ofstream (filename.str ().c_str (), std::ios::binary);
+  if (!*os)
+    {
+      NS_FATAL_ERROR ("cannot open " << filename.str ());
+    }
+  m_recording = os;
+  CallRecordingHeader header;
+  header.magic = CALL_RECORDING_MAGIC;
+  header.version = CALL_RECORDING_VERSION;
+  header.recordSize = sizeof (CallRecord);
+  header.reserved = 0;
+  m_recording->write (reinterpret_cast<const char *> (&header), sizeof (header));
+  //the current configuration, as if it was set up now
+  RecordCall (CALL_SET_SLOT, TRACE_ALL_STATES, m_slot);
+  RecordCall (CALL_SET_SIFS, TRACE_ALL_STATES, m_sifs.GetTimeStep ());
+  RecordCall (CALL_SET_EIFS_NO_DIFS, TRACE_ALL_STATES, m_eifsNoDifs.GetTimeStep ());
+  for (uint32_t i = 0; i < m_states.size (); i++)
+    {
+      RecordCall (CALL_ADD, i, GetAddRecordArg (m_aifsns[i], m_edcaSlots[i] != 0, m_backoffSlots[i]));
+    }
+}
+
+std::string
+DcfManager::GetRecordFilePrefix (void) const
+{
+  return m_recordFilePrefix;
+}
+
+int64_t
+DcfManager::GetAddRecordArg (uint32_t aifsn, bool edca, uint32_t backoffSlots)
+{
+  return static_cast<int64_t> (aifsn)
+         | (static_cast<int64_t> (edca ? 1 : 0) << 32)
+         | (static_cast<int64_t> (backoffSlots) << 33);
+}
+
+void
+DcfManager::RecordCall (CallRecordType type, uint32_t index, int64_t arg)
+{
+  if (m_recording == 0)
+    {
+      return;
+    }
+  CallRecord record;
+  record.time = Simulator::Now ().GetTimeStep ();
+  record.arg = arg;
+  record.index = index;
+  record.type = type;
+  record.depth = m_recordDepth;
+  m_recording->write (reinterpret_cast<const char *> (&record), sizeof (record));
+}
+
+const char *
+DcfManager::GetCallRecordTypeName (uint32_t type)
+{
+  switch (type)
+    {
+    case CALL_SET_SLOT:
+      return "set-slot";
+    case CALL_SET_SIFS:
+      return "set-sifs";
+    case CALL_SET_EIFS_NO_DIFS:
+      return "set-eifs-no-difs";
+    case CALL_ADD:
+      return "add";
+    case CALL_SET_AIFSN:
+      return "set-aifsn";
+    case CALL_BACKOFF_START:
+      return "backoff-start";
+    case CALL_REQUEST_ACCESS:
+      return "request-access";
+    case CALL_RX_START:
+      return "rx-start";
+    case CALL_RX_END_OK:
+      return "rx-end-ok";
+    case CALL_RX_END_ERROR:
+      return "rx-end-error";
+    case CALL_TX_START:
+      return "tx-start";
+    case CALL_BUSY_START:
+      return "busy-start";
+    case CALL_SWITCHING_START:
+      return "switching-start";
+    case CALL_SLEEP:
+      return "sleep";
+    case CALL_WAKEUP:
+      return "wakeup";
+    case CALL_NAV_RESET:
+      return "nav-reset";
+    case CALL_NAV_START:
+      return "nav-start";
+    case CALL_ACK_TIMEOUT_START:
+      return "ack-timeout-start";
+    case CALL_ACK_TIMEOUT_RESET:
+      return "ack-timeout-reset";
+    case CALL_CTS_TIMEOUT_START:
+      return "cts-timeout-start";
+    case CALL_CTS_TIMEOUT_RESET:
+      return "cts-timeout-reset";
+    case CALL_ACCESS_TIMEOUT:
+      return "access-timeout";
+    case CALL_NOTIFY_ACCESS_GRANTED:
+      return "notify-access-granted";
+    case CALL_NOTIFY_COLLISION:
+      return "notify-collision";
+    case CALL_NOTIFY_INTERNAL_COLLISION:
+      return "notify-internal-collision";
+    case CALL_NOTIFY_CHANNEL_SWITCHING:
+      return "notify-channel-switching";
+    case CALL_NOTIFY_SLEEP:
+      return "notify-sleep";
+    case CALL_NOTIFY_WAKEUP:
+      return "notify-wakeup";
+    default:
+      return "unknown";
+    }
+}
+
+Time
+DcfManager::MostRecent (Time a, Time b) const
+{
+  return Max (a, b);
+}
+
+Time
+DcfManager::MostRecent (Time a, Time b, Time c) const
+{
+  Time retval;
+  retval = Max (a, b);
+  retval = Max (retval, c);
+  return retval;
+}
+
+Time
+DcfManager::MostRecent (Time a, Time b, Time c, Time d) const
+{
+  Time e = Max (a, b);
+  Time f = Max (c, d);
+  Time retval = Max (e, f);
+  return retval;
+}
+
+Time
+DcfManager::MostRecent (Time a, Time b, Time c, Time d, Time e, Time f) const
+{
+  Time g = Max (a, b);
+  Time h = Max (c, d);
+  Time i = Max (e, f);
+  Time k = Max (g, h);
+  Time retval = Max (k, i);
+  return retval;
+}
+
+Time
+DcfManager::MostRecent (Time a, Time b, Time c, Time d, Time e, Time f, Time g) const
+{
+  Time h = Max (a, b);
+  Time i = Max (c, d);
+  Time j = Max (e, f);
+  Time k = Max (h, i);
+  Time l = Max (j, g);
+  Time retval = Max (k, l);
+  return retval;
+}
+
+bool
+DcfManager::IsBusy (void) const
+{
+  NS_LOG_FUNCTION (this);
+  // PHY busy
+  if (m_medium->IsRxing () && !IsOwnReception ())
+    {
+      return true;
+    }
+  if (m_medium->GetTxEnd () > Simulator::Now ()
+      || m_ownTxEnd > Simulator::Now ())
+    {
+      return true;
+    }
+  // NAV busy
+  Time lastNavEnd = m_lastNavStart + m_lastNavDuration;
+  if (lastNavEnd > Simulator::Now ())
+    {
+      return true;
+    }
+  return false;
+}
+
+void
+DcfManager::RequestAccess (DcfState *state)
+{
+  NS_LOG_FUNCTION (this << state);
+  CallScope scope (this, CALL_REQUEST_ACCESS, state->m_index, 0);
+  //Deny access if in sleep mode
+  if (m_sleeping)
     {
-      rxAccessStart = m_lastRxEnd + m_sifs;
-      if (!m_lastRxReceivedOk)
+      return;
+    }
+  m_fastGrantState = 0;
+  UpdateBackoff ();
+  NS_ASSERT (!state->IsAccessRequested ());
+  state->NotifyAccessRequested ();
+  m_nAccessRequested++;
+  /**
+   * If there is a collision, generate a backoff
+   * by notifying the collision to the user.
+   */
+  if (state->GetBackoffSlots () == 0
+      && IsBusy ())
+    {
+      RecordTrace (TRACE_COLLISION, state->m_index, 0);
+      /* someone else has accessed the medium.
+       * generate a backoff.
+       */
+      m_nCollisions++;
+      m_stateStatistics[state->m_index].collisions++;
+      m_collisionTrace (state->m_index);
+      state->NotifyCollision ();
+    }
+  PushBackoffIndexEntry (state);
+  DoGrantAccess ();
+  DoRestartAccessTimeoutIfNeeded ();
+}
+
+void
+DcfManager::DoGrantAccess (void)
+{
+  NS_LOG_FUNCTION (this);
+  RefreshBackoffIndex ();
+  /**
+   * Pop every DcfState whose backoff has expired and which needs access
+   * to the medium, i.e., it has data to send. Entries whose backoff end
+   * moved since they were pushed are put back with their current end.
+   *
+   * The expired DcfStates are stacked at the end of m_expiredStates,
+   * whose capacity is kept across calls: the notifications below may
+   * call back into RequestAccess, and thus into DoGrantAccess, which
+   * stacks its own DcfStates above ours and pops them before returning.
+   */
+  std::size_t first = m_expiredStates.size ();
+  while (!m_backoffIndex.empty ()
+         && m_backoffIndex.front ().backoffEnd <= Simulator::Now ())
+    {
+      BackoffIndexEntry entry = PopBackoffIndexEntry ();
+      if (!IsLiveBackoffIndexEntry (entry))
+        {
+          continue;
+        }
+      DcfState *state = m_states[entry.index];
+      if (GetBackoffEndFor (state) > Simulator::Now ())
+        {
+          PushBackoffIndexEntry (state);
+          continue;
+        }
+      m_expiredStates.push_back (state);
+    }
+  std::size_t end = m_expiredStates.size ();
+  if (end == first)
+    {
+      return;
+    }
+  std::sort (m_expiredStates.begin () + first, m_expiredStates.end (), &DcfManager::HasHigherPriority);
+
+  /**
+   * The first dcf in priority order gets access to the medium.
+   * All other dcfs with a lower priority whose backoff has expired
+   * and which needed access to the medium must be notified that we
+   * did get an internal collision.
+   */
+  DcfState *state = m_expiredStates[first];
+  RecordTrace (TRACE_GRANT, state->m_index, state->GetBackoffSlots ());
+  for (std::size_t j = first + 1; j < end; j++)
+    {
+      DcfState *otherState = m_expiredStates[j];
+      RecordTrace (TRACE_INTERNAL_COLLISION, otherState->m_index, otherState->GetBackoffSlots ());
+      m_nInternalCollisions++;
+      m_stateStatistics[otherState->m_index].internalCollisions++;
+      m_internalCollisionTrace (otherState->m_index);
+    }
+
+  /**
+   * Now, we notify all of these changes in one go. It is necessary to
+   * perform first the calculations of which states are colliding and then
+   * only apply the changes because applying the changes through notification
+   * could change the global state of the manager, and, thus, could change
+   * the result of the calculations.
+   */
+  m_nGrants++;
+  m_stateStatistics[state->m_index].grants++;
+  m_accessGrantedTrace (state->m_index);
+  m_nAccessRequested--;
+  state->NotifyAccessGranted ();
+  //indices rather than iterators: a nested call may grow the vector
+  for (std::size_t k = first + 1; k < end; k++)
+    {
+      m_expiredStates[k]->NotifyInternalCollision ();
+    }
+  /**
+   * The dcfs which suffered an internal collision are still waiting
+   * for access, with the new backoff they started in the notification.
+   */
+  for (std::size_t k = first + 1; k < end; k++)
+    {
+      if (m_expiredStates[k]->IsAccessRequested ())
+        {
+          PushBackoffIndexEntry (m_expiredStates[k]);
+        }
+    }
+  NS_ASSERT (m_expiredStates.size () == end);
+  m_expiredStates.resize (first);
+}
+
+void
+DcfManager::AccessTimeout (void)
+{
+  NS_LOG_FUNCTION (this);
+  CallScope scope (this, CALL_ACCESS_TIMEOUT, TRACE_ALL_STATES, 0);
+  m_accessTimeoutTrace ();
+  RecordTrace (TRACE_ACCESS_TIMEOUT, TRACE_ALL_STATES, 0);
+  if (m_fastGrantState != 0)
+    {
+      DcfState *state = m_fastGrantState;
+      m_fastGrantState = 0;
+      /**
+       * Nothing happened on the medium since this timeout was scheduled
+       * for the backoff end of the only DcfState which needs access, and
+       * no other DcfState has backoff slots to count down: its backoff
+       * has just expired, so grant access without re-evaluating anything.
+       * The backoff end is checked again, in case a path which does not
+       * clear m_fastGrantState moved it since.
+       */
+      uint32_t remainingSlots = state->GetBackoffSlots ();
+      if (Simulator::Now () == m_fastGrantEnd
+          && GetBackoffEndFor (state) == m_fastGrantEnd
+          && m_nAccessRequested == 1
+          && state->IsAccessRequested ()
+          && m_nActiveBackoffs == (remainingSlots > 0 ? 1 : 0))
+        {
+          state->UpdateBackoffSlotsNow (remainingSlots, Simulator::Now ());
+          RecordTrace (TRACE_GRANT, state->m_index, 0);
+          m_nGrants++;
+          m_stateStatistics[state->m_index].grants++;
+          m_accessGrantedTrace (state->m_index);
+          m_nAccessRequested--;
+          state->NotifyAccessGranted ();
+          return;
+        }
+    }
+  UpdateBackoff ();
+  DoGrantAccess ();
+  DoRestartAccessTimeoutIfNeeded ();
+}
+
+void
+DcfManager::ScheduleAccessTimeout (Time delay)
+{
+  m_accessTimeout = Simulator::Schedule (delay, Ptr<EventImpl> (Create<AccessTimeoutEvent> (this)));
+}
+
+bool
+DcfManager::HasHigherPriority (const DcfState *a, const DcfState *b)
+{
+  return a->m_index < b->m_index;
+}
+
+bool
+DcfManager::BackoffIndexEntry::operator< (const BackoffIndexEntry &o) const
+{
+  //std::push_heap builds a max-heap: the "largest" entry is the one
+  //with the earliest backoff end and, for equal ends, the highest priority.
+  if (backoffEnd != o.backoffEnd)
+    {
+      return backoffEnd > o.backoffEnd;
+    }
+  return index > o.index;
+}
+
+void
+DcfManager::PushBackoffIndexEntry (DcfState *state)
+{
+  BackoffIndexEntry entry;
+  entry.backoffEnd = GetBackoffEndFor (state);
+  entry.index = state->m_index;
+  entry.version = ++m_backoffIndexVersions[state->m_index];
+  m_backoffIndex.push_back (entry);
+  std::push_heap (m_backoffIndex.begin (), m_backoffIndex.end ());
+}
+
+DcfManager::BackoffIndexEntry
+DcfManager::PopBackoffIndexEntry (void)
+{
+  std::pop_heap (m_backoffIndex.begin (), m_backoffIndex.end ());
+  BackoffIndexEntry entry = m_backoffIndex.back ();
+  m_backoffIndex.pop_back ();
+  return entry;
+}
+
+bool
+DcfManager::IsLiveBackoffIndexEntry (const BackoffIndexEntry &entry) const
+{
+  return entry.version == m_backoffIndexVersions[entry.index]
+         && m_states[entry.index]->IsAccessRequested ();
+}
+
+void
+DcfManager::RefreshBackoffIndex (void)
+{
+  if (!m_backoffIndexDirty
+      && m_backoffIndex.size () <= 2 * m_states.size () + 8)
+    {
+      return;
+    }
+  NS_LOG_FUNCTION (this);
+  m_backoffIndexDirty = false;
+  m_backoffIndex.clear ();
+  for (States::const_iterator i = m_states.begin (); i != m_states.end (); i++)
+    {
+      if ((*i)->IsAccessRequested ())
         {
-          rxAccessStart += m_eifsNoDifs;
+          PushBackoffIndexEntry (*i);
         }
     }
+}
+
+Time
+DcfManager::GetAccessGrantStart (void) const
+{
+  return m_accessGrantStart;
+}
+
+void
+DcfManager::UpdateAccessGrantStart (void)
+{
+  /**
+   * Access starts a SIFS after the end of the latest of these events,
+   * so the SIFS is added once to the latest end rather than to each.
+   */
+  Time mediumEnd = m_medium->GetAccessStart ();
+  bool eifs = m_medium->IsAccessStartEifs ();
+  if (IsOwnReception ())
+    {
+      mediumEnd = m_medium->GetAccessStartWithoutRx ();
+      eifs = false;
+    }
+  mediumEnd = Max (mediumEnd, m_ownTxEnd);
+  Time navEnd = m_lastNavStart + m_lastNavDuration;
+  Time previousAccessGrantStart = m_accessGrantStart;
+  //the medium changed: the next access timeout takes the full path
+  m_fastGrantState = 0;
+  Time timeoutEnd = Max (m_lastAckTimeoutEnd, m_lastCtsTimeoutEnd);
+  Time deferralEnd = MostRecent (mediumEnd, navEnd, timeoutEnd);
+  AccountDeferral ();
+  m_deferralEnd = deferralEnd;
+  if (deferralEnd == mediumEnd)
+    {
+      m_deferralCause = eifs ? DEFERRAL_EIFS : DEFERRAL_BUSY;
+    }
   else
     {
-      rxAccessStart = m_lastRxStart + m_lastRxDuration + m_sifs;
-    }
-  Time busyAccessStart = m_lastBusyStart + m_lastBusyDuration + m_sifs;
-  Time txAccessStart = m_lastTxStart + m_lastTxDuration + m_sifs;
-  Time navAccessStart = m_lastNavStart + m_lastNavDuration + m_sifs;
-  Time ackTimeoutAccessStart = m_lastAckTimeoutEnd + m_sifs;
-  Time ctsTimeoutAccessStart = m_lastCtsTimeoutEnd + m_sifs;
-  Time switchingAccessStart = m_lastSwitchingStart + m_lastSwitchingDuration + m_sifs;
-  Time accessGrantedStart = MostRecent (rxAccessStart,
-                                        busyAccessStart,
-                                        txAccessStart,
-                                        navAccessStart,
-                                        ackTimeoutAccessStart,
-                                        ctsTimeoutAccessStart,
-                                        switchingAccessStart
-                                        );
-  NS_LOG_INFO ("access grant start=" << accessGrantedStart <<
-               ", rx access start=" << rxAccessStart <<
-               ", busy access start=" << busyAccessStart <<
-               ", tx access start=" << txAccessStart <<
-               ", nav access start=" << navAccessStart);
-  return accessGrantedStart;
+      m_deferralCause = (deferralEnd == navEnd) ? DEFERRAL_NAV : DEFERRAL_TIMEOUT;
+    }
+  m_accessGrantStart = deferralEnd + m_sifs;
+  if (m_accessGrantStart < previousAccessGrantStart)
+    {
+      //backoff ends may have moved backward: the index must be rebuilt.
+      m_backoffIndexDirty = true;
+    }
+}
+
+bool
+DcfManager::IsOwnReception (void) const
+{
+  Time rxStart = m_medium->GetRxStart ();
+  return m_medium->GetGroupId () != 0
+         && m_ownTxEnd.IsStrictlyPositive ()
+         && rxStart >= m_ownTxStart
+         && rxStart <= m_ownTxEnd;
+}
+
+void
+DcfManager::AccountDeferral (void)
+{
+  Time now = Simulator::Now ();
+  if (m_deferralEnd > m_deferralCheckpoint)
+    {
+      m_deferrals[m_deferralCause] += Min (now, m_deferralEnd) - m_deferralCheckpoint;
+    }
+  m_deferralCheckpoint = now;
 }
 
 Time
 DcfManager::GetBackoffStartFor (DcfState *state)
 {
-  NS_LOG_FUNCTION (this << state);
-  Time mostRecentEvent = MostRecent (state->GetBackoffStart (),
-                                     GetAccessGrantStart () + MicroSeconds (state->GetAifsn () * m_slotTimeUs));
-
-  return mostRecentEvent;
+  uint32_t index = state->m_index;
+  int64_t aifsEnd = m_accessGrantStart.GetTimeStep () + m_aifsns[index] * m_slot;
+  return TimeStep (std::max (m_backoffStarts[index], aifsEnd));
 }
 
 Time
 DcfManager::GetBackoffEndFor (DcfState *state)
 {
-  return GetBackoffStartFor (state) + MicroSeconds (state->GetBackoffSlots () * m_slotTimeUs);
+  uint32_t index = state->m_index;
+  int64_t aifsEnd = m_accessGrantStart.GetTimeStep () + m_aifsns[index] * m_slot;
+  return TimeStep (std::max (m_backoffStarts[index], aifsEnd) + m_backoffSlots[index] * m_slot);
 }
 
 void
 DcfManager::UpdateBackoff (void)
 {
-  NS_LOG_FUNCTION (this);
-  uint32_t k = 0;
-  for (States::const_iterator i = m_states.begin (); i != m_states.end (); i++, k++)
+  /*
+   * Backoff accounting is lazy: nothing needs to be counted down
+   * if no DcfState has backoff slots left, or if we are still before
+   * the access grant start, since no AIFS can have elapsed yet.
+   * A DcfState with no slot left would only move its backoff start
+   * to its AIFS end, which is already in the past and so cannot
+   * change any later access decision.
+   */
+  if (m_mediumIndex == DcfMediumState::NO_MEDIUM_INDEX)
     {
-      DcfState *state = *i;
-
-      Time backoffStart = GetBackoffStartFor (state);
-      if (backoffStart <= Simulator::Now ())
-        {
-          uint32_t nus = (Simulator::Now () - backoffStart).GetMicroSeconds ();
-          uint32_t nIntSlots = nus / m_slotTimeUs;
-          /*
-           * EDCA behaves slightly different to DCA. For EDCA we
-           * decrement once at the slot boundary at the end of AIFS as
-           * well as once at the end of each clear slot
-           * thereafter. For DCA we only decrement at the end of each
-           * clear slot after DIFS. We account for the extra backoff
-           * by incrementing the slot count here in the case of
-           * EDCA. The if statement whose body we are in has confirmed
-           * that a minimum of AIFS has elapsed since last busy
-           * medium.
-           */
-          if (state->IsEdca ())
-            {
-              nIntSlots++;
-            }
-          uint32_t n = std::min (nIntSlots, state->GetBackoffSlots ());
-          MY_DEBUG ("dcf " << k << " dec backoff slots=" << n);
-          Time backoffUpdateBound = backoffStart + MicroSeconds (n * m_slotTimeUs);
-          state->UpdateBackoffSlotsNow (n, backoffUpdateBound);
-        }
+      //we do not follow the medium events of our group while sleeping: catch up
+      UpdateAccessGrantStart ();
+    }
+  if (m_nActiveBackoffs == 0
+      || m_accessGrantStart > Simulator::Now ())
+    {
+      return;
+    }
+  uint32_t nStates = m_states.size ();
+  /*
+   * The backoff fields of all the DcfStates are stored in contiguous
+   * arrays, so this loop runs over plain integers in simulator ticks
+   * and has no data-dependent branch.
+   *
+   * EDCA behaves slightly different to DCA. For EDCA we
+   * decrement once at the slot boundary at the end of AIFS as
+   * well as once at the end of each clear slot
+   * thereafter. For DCA we only decrement at the end of each
+   * clear slot after DIFS. We account for the extra backoff
+   * by adding m_edcaSlots (1 for EDCA, 0 for DCA) to the slot
+   * count. The count is only applied if a minimum of AIFS has
+   * elapsed since last busy medium.
+   */
+  const int64_t now = Simulator::Now ().GetTimeStep ();
+  const int64_t accessGrantStart = m_accessGrantStart.GetTimeStep ();
+  const int64_t slot = m_slot;
+  NS_ASSERT_MSG (slot > 0, "the slot duration must be set before backoffs are counted down");
+  uint32_t *slots = &m_backoffSlots[0];
+  int64_t *starts = &m_backoffStarts[0];
+  const uint32_t *aifsns = &m_aifsns[0];
+  const uint32_t *edcaSlots = &m_edcaSlots[0];
+  uint32_t nExhausted = 0;
+  uint32_t nDecremented = 0;
+  for (uint32_t i = 0; i < nStates; i++)
+    {
+      int64_t aifsEnd = accessGrantStart + aifsns[i] * slot;
+      int64_t backoffStart = std::max (starts[i], aifsEnd);
+      bool elapsed = backoffStart <= now;
+      //clamped, so that the count stays defined when the backoff has not started
+      uint32_t nIntSlots = static_cast<uint32_t> (std::max<int64_t> (now - backoffStart, 0) / slot) + edcaSlots[i];
+      uint32_t n = elapsed ? std::min (nIntSlots, slots[i]) : 0;
+      nExhausted += (n > 0 && n == slots[i]);
+      nDecremented += n;
+      slots[i] -= n;
+      starts[i] = elapsed ? backoffStart + n * slot : starts[i];
+    }
+  m_nActiveBackoffs -= nExhausted;
+  if (nDecremented > 0)
+    {
+      RecordTrace (TRACE_BACKOFF_UPDATE, TRACE_ALL_STATES, nDecremented);
     }
 }
 
 void
 DcfManager::DoRestartAccessTimeoutIfNeeded (void)
 {
-  NS_LOG_FUNCTION (this);
+  RefreshBackoffIndex ();
   /**
    * Is there a DcfState which needs to access the medium, and,
    * if there is one, how many slots for AIFS+backoff does it require ?
+   *
+   * Backoff ends only move forward between two rebuilds of the index,
+   * so the first live entry whose recorded end is still up to date
+   * is the earliest one. Expired entries are set aside and pushed
+   * back once the search is over.
    */
   bool accessTimeoutNeeded = false;
   Time expectedBackoffEnd = Simulator::GetMaximumSimulationTime ();
-  for (States::const_iterator i = m_states.begin (); i != m_states.end (); i++)
+  DcfState *nextState = 0;
+  std::size_t first = m_expiredStates.size ();
+  while (!m_backoffIndex.empty ())
     {
-      DcfState *state = *i;
-      if (state->IsAccessRequested ())
+      BackoffIndexEntry entry = m_backoffIndex.front ();
+      if (!IsLiveBackoffIndexEntry (entry))
+        {
+          PopBackoffIndexEntry ();
+          continue;
+        }
+      DcfState *state = m_states[entry.index];
+      Time tmp = GetBackoffEndFor (state);
+      if (tmp != entry.backoffEnd)
+        {
+          PopBackoffIndexEntry ();
+          PushBackoffIndexEntry (state);
+          continue;
+        }
+      if (tmp > Simulator::Now ())
         {
-          Time tmp = GetBackoffEndFor (state);
-          if (tmp > Simulator::Now ())
-            {
-              accessTimeoutNeeded = true;
-              expectedBackoffEnd = std::min (expectedBackoffEnd, tmp);
-            }
+          accessTimeoutNeeded = true;
+          expectedBackoffEnd = tmp;
+          nextState = state;
+          break;
         }
+      PopBackoffIndexEntry ();
+      m_expiredStates.push_back (state);
+    }
+  for (std::size_t i = first; i < m_expiredStates.size (); i++)
+    {
+      PushBackoffIndexEntry (m_expiredStates[i]);
     }
+  m_expiredStates.resize (first);
   if (accessTimeoutNeeded)
     {
-      MY_DEBUG ("expected backoff end=" << expectedBackoffEnd);
+      RecordTrace (TRACE_ACCESS_TIMEOUT_START, TRACE_ALL_STATES, expectedBackoffEnd.GetTimeStep ());
       Time expectedBackoffDelay = expectedBackoffEnd - Simulator::Now ();
-      totalDelay = totalDelay + expectedBackoffDelay;
-      //std::cout << totalDelay << "\n";
-      NS_LOG_UNCOND(totalDelay); 
+      m_totalBackoffDelay += expectedBackoffDelay;
+      if (m_slot > 0)
+        {
+          m_backoffDelayHistogram[GetBackoffBin (expectedBackoffDelay.GetTimeStep () / m_slot)]++;
+        }
+      m_backoffDelayTrace (expectedBackoffDelay);
+      /**
+       * A timeout which expires too late is taken out of the scheduler
+       * rather than cancelled, so that moving it earlier does not leave
+       * a dead event behind, and the memory of its event is reused by
+       * the next one. A timeout which expires earlier is kept: it
+       * will re-evaluate the backoffs and restart itself if needed.
+       */
       if (m_accessTimeout.IsRunning ()
           && Simulator::GetDelayLeft (m_accessTimeout) > expectedBackoffDelay)
         {
-          m_accessTimeout.Cancel ();
+          Simulator::Remove (m_accessTimeout);
         }
       if (m_accessTimeout.IsExpired ())
         {
-          m_accessTimeout = Simulator::Schedule (expectedBackoffDelay,
-                                                 &DcfManager::AccessTimeout, this);
+          ScheduleAccessTimeout (expectedBackoffDelay);
+        }
+      /**
+       * With a single contender, the access timeout which expires at
+       * its backoff end can grant access directly, unless anything
+       * happens on the medium in the meantime.
+       */
+      if (m_nAccessRequested == 1
+          && Simulator::GetDelayLeft (m_accessTimeout) == expectedBackoffDelay)
+        {
+          m_fastGrantState = nextState;
+          m_fastGrantEnd = expectedBackoffEnd;
         }
     }
 }
@@ -718,88 +2075,97 @@ DcfManager::DoRestartAccessTimeoutIfNeeded (void)
 void
 DcfManager::NotifyRxStartNow (Time duration)
 {
-  NS_LOG_FUNCTION (this << duration);
-  MY_DEBUG ("rx start for=" << duration);
-  UpdateBackoff ();
-  m_lastRxStart = Simulator::Now ();
-  m_lastRxDuration = duration;
-  m_rxing = true;
+  NS_LOG_FUNCTION (this);
+  CallScope scope (this, CALL_RX_START, TRACE_ALL_STATES, duration.GetTimeStep ());
+  if (!m_medium->AcquireFeeder (this))
+    {
+      return;
+    }
+  RecordTrace (TRACE_RX_START, TRACE_ALL_STATES, duration.GetTimeStep ());
+  m_medium->NotifyRxStartNow (duration);
 }
 
 void
 DcfManager::NotifyRxEndOkNow (void)
 {
   NS_LOG_FUNCTION (this);
-  MY_DEBUG ("rx end ok");
-  m_lastRxEnd = Simulator::Now ();
-  m_lastRxReceivedOk = true;
-  m_rxing = false;
+  CallScope scope (this, CALL_RX_END_OK, TRACE_ALL_STATES, 0);
+  if (!m_medium->AcquireFeeder (this))
+    {
+      return;
+    }
+  RecordTrace (TRACE_RX_END_OK, TRACE_ALL_STATES, 0);
+  m_medium->NotifyRxEndOkNow ();
 }
 
 void
 DcfManager::NotifyRxEndErrorNow (void)
 {
   NS_LOG_FUNCTION (this);
-  MY_DEBUG ("rx end error");
-  m_lastRxEnd = Simulator::Now ();
-  m_lastRxReceivedOk = false;
-  m_rxing = false;
+  CallScope scope (this, CALL_RX_END_ERROR, TRACE_ALL_STATES, 0);
+  if (!m_medium->AcquireFeeder (this))
+    {
+      return;
+    }
+  RecordTrace (TRACE_RX_END_ERROR, TRACE_ALL_STATES, 0);
+  m_medium->NotifyRxEndErrorNow ();
 }
 
 void
 DcfManager::NotifyTxStartNow (Time duration)
 {
-  NS_LOG_FUNCTION (this << duration);
-  if (m_rxing)
+  NS_LOG_FUNCTION (this);
+  CallScope scope (this, CALL_TX_START, TRACE_ALL_STATES, duration.GetTimeStep ());
+  if (m_medium->GetGroupId () != 0)
     {
-      //this may be caused only if PHY has started to receive a packet
-      //inside SIFS, so, we check that lastRxStart was maximum a SIFS ago
-      NS_ASSERT (Simulator::Now () - m_lastRxStart <= m_sifs);
-      m_lastRxEnd = Simulator::Now ();
-      m_lastRxDuration = m_lastRxEnd - m_lastRxStart;
-      m_lastRxReceivedOk = true;
-      m_rxing = false;
+      //defer to our own transmission before the group hears it
+      UpdateBackoff ();
+      m_ownTxStart = Simulator::Now ();
+      m_ownTxEnd = m_ownTxStart + duration;
+      UpdateAccessGrantStart ();
     }
-  MY_DEBUG ("tx start for " << duration);
-  UpdateBackoff ();
-  m_lastTxStart = Simulator::Now ();
-  m_lastTxDuration = duration;
+  if (!m_medium->AcquireFeeder (this))
+    {
+      return;
+    }
+  RecordTrace (TRACE_TX_START, TRACE_ALL_STATES, duration.GetTimeStep ());
+  m_medium->NotifyTxStartNow (duration);
 }
 
 void
 DcfManager::NotifyMaybeCcaBusyStartNow (Time duration)
 {
-  NS_LOG_FUNCTION (this << duration);
-  MY_DEBUG ("busy start for " << duration);
-  UpdateBackoff ();
-  m_lastBusyStart = Simulator::Now ();
-  m_lastBusyDuration = duration;
+  NS_LOG_FUNCTION (this);
+  CallScope scope (this, CALL_BUSY_START, TRACE_ALL_STATES, duration.GetTimeStep ());
+  if (!m_medium->AcquireFeeder (this))
+    {
+      return;
+    }
+  RecordTrace (TRACE_BUSY_START, TRACE_ALL_STATES, duration.GetTimeStep ());
+  m_medium->NotifyMaybeCcaBusyStartNow (duration);
 }
 
 void
 DcfManager::NotifySwitchingStartNow (Time duration)
 {
-  NS_LOG_FUNCTION (this << duration);
-  Time now = Simulator::Now ();
-  NS_ASSERT (m_lastTxStart + m_lastTxDuration <= now);
-  NS_ASSERT (m_lastSwitchingStart + m_lastSwitchingDuration <= now);
-
-  if (m_rxing)
+  NS_LOG_FUNCTION (this);
+  CallScope scope (this, CALL_SWITCHING_START, TRACE_ALL_STATES, duration.GetTimeStep ());
+  if (!m_medium->AcquireFeeder (this))
     {
-      //channel switching during packet reception
-      m_lastRxEnd = Simulator::Now ();
-      m_lastRxDuration = m_lastRxEnd - m_lastRxStart;
-      m_lastRxReceivedOk = true;
-      m_rxing = false;
+      return;
     }
+  m_medium->NotifySwitchingStartNow (duration);
+}
+
+void
+DcfManager::DoNotifySwitchingStart (Time duration)
+{
+  NS_LOG_FUNCTION (this);
+  Time now = Simulator::Now ();
   if (m_lastNavStart + m_lastNavDuration > now)
     {
       m_lastNavDuration = now - m_lastNavStart;
     }
-  if (m_lastBusyStart + m_lastBusyDuration > now)
-    {
-      m_lastBusyDuration = now - m_lastBusyStart;
-    }
   if (m_lastAckTimeoutEnd > now)
     {
       m_lastAckTimeoutEnd = now;
@@ -808,14 +2174,14 @@ DcfManager::NotifySwitchingStartNow (Time duration)
     {
       m_lastCtsTimeoutEnd = now;
     }
+  UpdateAccessGrantStart ();
 
-  //Cancel timeout
-  if (m_accessTimeout.IsRunning ())
-    {
-      m_accessTimeout.Cancel ();
-    }
+  //Remove timeout
+  Simulator::Remove (m_accessTimeout);
 
   //Reset backoffs
+  m_backoffIndexDirty = true;
+  m_fastGrantState = 0;
   for (States::iterator i = m_states.begin (); i != m_states.end (); i++)
     {
       DcfState *state = *i;
@@ -826,28 +2192,37 @@ DcfManager::NotifySwitchingStartNow (Time duration)
           NS_ASSERT (state->GetBackoffSlots () == 0);
         }
       state->ResetCw ();
+      if (state->m_accessRequested)
+        {
+          m_nAccessRequested--;
+        }
       state->m_accessRequested = false;
       state->NotifyChannelSwitching ();
     }
 
-  MY_DEBUG ("switching start for " << duration);
-  m_lastSwitchingStart = Simulator::Now ();
-  m_lastSwitchingDuration = duration;
-
+  RecordTrace (TRACE_SWITCHING_START, TRACE_ALL_STATES, duration.GetTimeStep ());
 }
 
 void
 DcfManager::NotifySleepNow (void)
 {
   NS_LOG_FUNCTION (this);
+  CallScope scope (this, CALL_SLEEP, TRACE_ALL_STATES, 0);
   m_sleeping = true;
-  //Cancel timeout
-  if (m_accessTimeout.IsRunning ())
+  /**
+   * Our own PHY reports nothing while sleeping, but the other PHYs of a
+   * medium group do: stop following the group until we wake up.
+   */
+  if (m_medium->GetGroupId () != 0)
     {
-      m_accessTimeout.Cancel ();
+      m_medium->Leave (this);
     }
+  //Remove timeout
+  Simulator::Remove (m_accessTimeout);
 
   //Reset backoffs
+  m_backoffIndexDirty = true;
+  m_fastGrantState = 0;
   for (States::iterator i = m_states.begin (); i != m_states.end (); i++)
     {
       DcfState *state = *i;
@@ -859,7 +2234,19 @@ void
 DcfManager::NotifyWakeupNow (void)
 {
   NS_LOG_FUNCTION (this);
+  CallScope scope (this, CALL_WAKEUP, TRACE_ALL_STATES, 0);
   m_sleeping = false;
+  if (m_mediumIndex == DcfMediumState::NO_MEDIUM_INDEX)
+    {
+      m_medium->Join (this);
+      if (m_phyListener != 0)
+        {
+          m_medium->AcquireFeeder (this);
+        }
+      UpdateAccessGrantStart ();
+    }
+  m_backoffIndexDirty = true;
+  m_fastGrantState = 0;
   for (States::iterator i = m_states.begin (); i != m_states.end (); i++)
     {
       DcfState *state = *i;
@@ -870,6 +2257,10 @@ DcfManager::NotifyWakeupNow (void)
           NS_ASSERT (state->GetBackoffSlots () == 0);
         }
       state->ResetCw ();
+      if (state->m_accessRequested)
+        {
+          m_nAccessRequested--;
+        }
       state->m_accessRequested = false;
       state->NotifyWakeUp ();
     }
@@ -878,11 +2269,13 @@ DcfManager::NotifyWakeupNow (void)
 void
 DcfManager::NotifyNavResetNow (Time duration)
 {
-  NS_LOG_FUNCTION (this << duration);
-  MY_DEBUG ("nav reset for=" << duration);
+  NS_LOG_FUNCTION (this);
+  CallScope scope (this, CALL_NAV_RESET, TRACE_ALL_STATES, duration.GetTimeStep ());
+  RecordTrace (TRACE_NAV_RESET, TRACE_ALL_STATES, duration.GetTimeStep ());
   UpdateBackoff ();
   m_lastNavStart = Simulator::Now ();
   m_lastNavDuration = duration;
+  UpdateAccessGrantStart ();
   UpdateBackoff ();
   /**
    * If the nav reset indicates an end-of-nav which is earlier
@@ -896,9 +2289,10 @@ DcfManager::NotifyNavResetNow (Time duration)
 void
 DcfManager::NotifyNavStartNow (Time duration)
 {
-  NS_LOG_FUNCTION (this << duration);
+  NS_LOG_FUNCTION (this);
+  CallScope scope (this, CALL_NAV_START, TRACE_ALL_STATES, duration.GetTimeStep ());
   NS_ASSERT (m_lastNavStart <= Simulator::Now ());
-  MY_DEBUG ("nav start for=" << duration);
+  RecordTrace (TRACE_NAV_START, TRACE_ALL_STATES, duration.GetTimeStep ());
   UpdateBackoff ();
   Time newNavEnd = Simulator::Now () + duration;
   Time lastNavEnd = m_lastNavStart + m_lastNavDuration;
@@ -906,37 +2300,46 @@ DcfManager::NotifyNavStartNow (Time duration)
     {
       m_lastNavStart = Simulator::Now ();
       m_lastNavDuration = duration;
+      UpdateAccessGrantStart ();
     }
 }
 
 void
 DcfManager::NotifyAckTimeoutStartNow (Time duration)
 {
-  NS_LOG_FUNCTION (this << duration);
+  NS_LOG_FUNCTION (this);
+  CallScope scope (this, CALL_ACK_TIMEOUT_START, TRACE_ALL_STATES, duration.GetTimeStep ());
   NS_ASSERT (m_lastAckTimeoutEnd < Simulator::Now ());
   m_lastAckTimeoutEnd = Simulator::Now () + duration;
+  UpdateAccessGrantStart ();
 }
 
 void
 DcfManager::NotifyAckTimeoutResetNow ()
 {
   NS_LOG_FUNCTION (this);
+  CallScope scope (this, CALL_ACK_TIMEOUT_RESET, TRACE_ALL_STATES, 0);
   m_lastAckTimeoutEnd = Simulator::Now ();
+  UpdateAccessGrantStart ();
   DoRestartAccessTimeoutIfNeeded ();
 }
 
 void
 DcfManager::NotifyCtsTimeoutStartNow (Time duration)
 {
-  NS_LOG_FUNCTION (this << duration);
+  NS_LOG_FUNCTION (this);
+  CallScope scope (this, CALL_CTS_TIMEOUT_START, TRACE_ALL_STATES, duration.GetTimeStep ());
   m_lastCtsTimeoutEnd = Simulator::Now () + duration;
+  UpdateAccessGrantStart ();
 }
 
 void
 DcfManager::NotifyCtsTimeoutResetNow ()
 {
   NS_LOG_FUNCTION (this);
+  CallScope scope (this, CALL_CTS_TIMEOUT_RESET, TRACE_ALL_STATES, 0);
   m_lastCtsTimeoutEnd = Simulator::Now ();
+  UpdateAccessGrantStart ();
   DoRestartAccessTimeoutIfNeeded ();
 }
 } //namespace ns3
@@ -0,0 +1,1294 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2005,2006 INRIA
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mathieu Lacage <mathieu.lacage@sophia.inria.fr>
+ */
+
+#ifndef DCF_MANAGER_H
+#define DCF_MANAGER_H
+
+#include "ns3/nstime.h"
+#include "ns3/timer.h"
+#include "ns3/event-id.h"
+#include "ns3/ptr.h"
+#include "ns3/object.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/traced-callback.h"
+#include <vector>
+#include <ostream>
+#include <string>
+
+namespace ns3 {
+
+class WifiPhy;
+class DcfManager;
+class PhyListener;
+class LowDcfListener;
+class MacLow;
+
+/**
+ * \brief keep track of the state needed for a single DCF
+ * function.
+ * \ingroup wifi
+ *
+ * Multiple instances of a DcfState can be registered in a single
+ * DcfManager to implement 802.11e-style relative QoS.
+ * DcfState::SetAifsn and DcfState::SetCwBounds allow the user to
+ * control the relative QoS differentiation.
+ */
+class DcfState
+{
+public:
+  DcfState ();
+  virtual ~DcfState ();
+
+  /**
+   * \param aifsn the number of slots which make up an AIFS for a specific DCF.
+   *        a DIFS corresponds to an AIFSN = 2.
+   *
+   * Calling this method after DcfManager::Add has been called is not recommended.
+   */
+  void SetAifsn (uint32_t aifsn);
+  /**
+   * Set the minimum congestion window size.
+   *
+   * \param minCw the minimum congestion window size
+   */
+  void SetCwMin (uint32_t minCw);
+  /**
+   * Set the maximum congestion window size.
+   *
+   * \param maxCw the maximum congestion window size
+   */
+  void SetCwMax (uint32_t maxCw);
+  /**
+   * Return the number of slots that make up an AIFS.
+   *
+   * \return the number of slots that make up an AIFS
+   */
+  uint32_t GetAifsn (void) const;
+  /**
+   * Return the minimum congestion window size.
+   *
+   * \return the minimum congestion window size
+   */
+  uint32_t GetCwMin (void) const;
+  /**
+   * Return the maximum congestion window size.
+   *
+   * \return the maximum congestion window size
+   */
+  uint32_t GetCwMax (void) const;
+  /**
+   * Update the value of the CW variable to take into account
+   * a transmission success or a transmission abort (stop transmission
+   * of a packet after the maximum number of retransmissions has been
+   * reached). By default, this resets the CW variable to minCW.
+   */
+  void ResetCw (void);
+  /**
+   * Update the value of the CW variable to take into account
+   * a transmission failure. By default, this triggers a doubling
+   * of CW (capped by maxCW).
+   */
+  void UpdateFailedCw (void);
+  /**
+   * \param cw the current value of the CW variable
+   * \param cwMax the maximum congestion window size
+   *
+   * \return the value of the CW variable after a transmission failure,
+   *         as computed by UpdateFailedCw.
+   */
+  static uint32_t GetFailedCw (uint32_t cw, uint32_t cwMax);
+  /**
+   * \param nSlots the number of slots of the backoff.
+   *
+   * Start a backoff by initializing the backoff counter to the number of
+   * slots specified.
+   */
+  void StartBackoffNow (uint32_t nSlots);
+  /**
+   * \returns the current value of the CW variable. The initial value is
+   * minCW.
+   */
+  uint32_t GetCw (void) const;
+  /**
+   * \returns true if access has been requested for this DcfState and
+   *          has not been granted already, false otherwise.
+   */
+  bool IsAccessRequested (void) const;
+  /**
+   * \returns true if this DcfState implements the EDCA access rules
+   *          (one extra slot decrement at the end of AIFS), false for
+   *          the legacy DCF rules.
+   */
+  virtual bool IsEdca (void) const = 0;
+
+
+private:
+  friend class DcfManager;
+
+  /**
+   * Return the current number of backoff slots.
+   *
+   * \return the current number of backoff slots
+   */
+  uint32_t GetBackoffSlots (void) const;
+  /**
+   * Return the time when the backoff procedure started.
+   *
+   * \return the time when the backoff procedure started
+   */
+  Time GetBackoffStart (void) const;
+  /**
+   * Update backoff slots that nSlots has passed.
+   *
+   * \param nSlots
+   * \param backoffUpdateBound
+   */
+  void UpdateBackoffSlotsNow (uint32_t nSlots, Time backoffUpdateBound);
+  /**
+   * Notify that access request has been received.
+   */
+  void NotifyAccessRequested (void);
+  /**
+   * Notify that access has been granted.
+   */
+  void NotifyAccessGranted (void);
+  /**
+   * Notify that collision has occurred.
+   */
+  void NotifyCollision (void);
+  /**
+   * Notify that internal collision has occurred.
+   */
+  void NotifyInternalCollision (void);
+  /**
+   * Notify that the device is switching channel.
+   */
+  void NotifyChannelSwitching (void);
+  /**
+   * Notify that the device has started to sleep.
+   */
+  void NotifySleep (void);
+  /**
+   * Notify that the device has started to wake up
+   */
+  void NotifyWakeUp (void);
+
+  /**
+   * Called by DcfManager to notify a DcfState subclass
+   * that access to the medium is granted and can
+   * start immediately.
+   */
+  virtual void DoNotifyAccessGranted (void) = 0;
+  /**
+   * Called by DcfManager to notify a DcfState subclass
+   * that an 'internal' collision occured, that is, that
+   * the backoff timer of a higher priority DcfState expired
+   * at the same time and that access was granted to this
+   * other higher priority DcfState.
+   *
+   * The subclass is expected to start a new backoff by
+   * calling DcfState::StartBackoffNow and DcfManager::RequestAccess
+   * is access is still needed.
+   */
+  virtual void DoNotifyInternalCollision (void) = 0;
+  /**
+   * Called by DcfManager to notify a DcfState subclass
+   * that a normal collision occured, that is, that
+   * the medium was busy when access was requested.
+   *
+   * The subclass is expected to start a new backoff by
+   * calling DcfState::StartBackoffNow and DcfManager::RequestAccess
+   * is access is still needed.
+   */
+  virtual void DoNotifyCollision (void) = 0;
+  /**
+   * Called by DcfManager to notify a DcfState subclass
+   * that a channel switching occured.
+   *
+   * The subclass is expected to flush the queue of packets.
+   */
+  virtual void DoNotifyChannelSwitching () = 0;
+  /**
+   * Called by DcfManager to notify a DcfState subclass that the device has
+   * begun to sleep.
+   *
+   * The subclass is expected to re-insert the pending packet into the queue
+   */
+  virtual void DoNotifySleep (void) = 0;
+  /**
+   * Called by DcfManager to notify a DcfState subclass that the device
+   * has begun to wake up.
+   *
+   * The subclass is expected to restart a new backoff by
+   * calling DcfState::StartBackoffNow and DcfManager::RequestAccess
+   * is access is still needed.
+   */
+  virtual void DoNotifyWakeUp (void) = 0;
+
+  DcfManager *m_manager; //!< the DcfManager this DcfState was added to, if any
+  uint32_t m_index; //!< priority index of this DcfState within its DcfManager
+  //the aifsn, backoffSlots and backoffStart variables are only
+  //used until the DcfState is added to a DcfManager, which then
+  //stores them for all its DcfStates.
+  uint32_t m_aifsn;
+  uint32_t m_backoffSlots;
+  //the backoffStart variable is used to keep track of the
+  //time at which a backoff was started or the time at which
+  //the backoff counter was last updated.
+  Time m_backoffStart;
+  uint32_t m_cwMin;
+  uint32_t m_cwMax;
+  uint32_t m_cw;
+  bool m_accessRequested;
+};
+
+
+/**
+ * \brief PHY view of the medium, shared by one or more DcfManagers
+ * \ingroup wifi
+ *
+ * Keeps track of the last rx, CCA busy, tx and channel switching events
+ * reported by a PHY, and of the time at which they let the medium be
+ * accessed again, before SIFS. On each event, the DcfManagers which use
+ * this DcfMediumState update their backoffs and access grant start.
+ *
+ * Each DcfManager has its own DcfMediumState, unless it joined a medium
+ * group (see the MediumGroup attribute of DcfManager): the DcfManagers of
+ * a group share one DcfMediumState, fed by the PHY of the first of them
+ * to set up its PHY listener or to report a PHY event (the feeder), and
+ * only keep their own NAV,
+ * ack timeout, CTS timeout, transmissions and sleep state. The rx, CCA
+ * busy and channel switching events reported by the PHYs of the other
+ * members are ignored. This is only correct for stations which all hear
+ * each other on the same channel: the transmissions of the other members
+ * are seen as receptions by the feeder, and so by all the members.
+ *
+ * To stay close to what the PHY of each member would report:
+ *  - each member defers to its own transmissions as soon as they start;
+ *  - the transmissions of the feeder reach the group after the events
+ *    already scheduled at the same time, so that a member whose backoff
+ *    ends in the same slot still transmits, as it would not have heard
+ *    the feeder yet;
+ *  - a reception which started during the transmission of a member is
+ *    its own frame, or a frame which collided with it: the PHY of the
+ *    member would not have received it, so it neither keeps the medium
+ *    busy for the member nor leads it to use EIFS.
+ * The members still see the transmissions of the others with the
+ * propagation delay to the feeder, and a collision between the feeder
+ * and a member is not seen as a reception error by the other members.
+ *
+ * A sleeping DcfManager leaves the members of its group, so that the
+ * medium events only cost the awake DcfManagers, and gives up feeding
+ * the group. It joins again when it wakes up, and then only has to
+ * recompute its access grant start from the cached access start.
+ */
+class DcfMediumState : public SimpleRefCount<DcfMediumState>
+{
+public:
+  /// Member index of a DcfManager which is not notified of the medium events
+  static const uint32_t NO_MEDIUM_INDEX = 0xffffffff;
+
+  /**
+   * \param group the medium group, 0 for the DcfMediumState of a
+   *        single DcfManager
+   */
+  DcfMediumState (uint32_t group);
+  ~DcfMediumState ();
+
+  /**
+   * \param group a medium group, not 0
+   * \return the DcfMediumState of the group, created if needed
+   */
+  static Ptr<DcfMediumState> GetGroup (uint32_t group);
+  /**
+   * Forget all the medium groups, so that the DcfManagers of a later
+   * simulation do not join the groups of this one. Called from
+   * Simulator::Destroy.
+   */
+  static void ForgetGroups (void);
+  /**
+   * \return the medium group, 0 for the DcfMediumState of a single DcfManager
+   */
+  uint32_t GetGroupId (void) const;
+
+  /**
+   * \param manager a DcfManager which starts to be notified of the
+   *        medium events
+   */
+  void Join (DcfManager *manager);
+  /**
+   * \param manager a DcfManager which stops to be notified of the medium
+   *        events. Nothing is done if it is not a member.
+   */
+  void Leave (DcfManager *manager);
+  /**
+   * \param manager a DcfManager of the group
+   * \return true if the PHY events should be taken from manager, i.e.,
+   *         if no other DcfManager of the group feeds it
+   */
+  bool AcquireFeeder (DcfManager *manager);
+  /**
+   * \param manager a DcfManager of the group which stops listening
+   *        to its PHY
+   */
+  void ReleaseFeeder (DcfManager *manager);
+  /**
+   * \param manager a DcfManager which uses this DcfMediumState
+   * \return true if the PHY events reported to manager should be applied
+   */
+  bool IsFeeder (const DcfManager *manager) const;
+
+  /**
+   * \param eifsNoDifs the duration of EIFS minus DIFS, added to the rx
+   *        end after a reception error
+   */
+  void SetEifsNoDifs (Time eifsNoDifs);
+  /**
+   * \return the end of the last rx, CCA busy, tx and channel switching
+   *         events, or the start of a reception in progress plus its
+   *         duration.
+   */
+  Time GetAccessStart (void) const;
+  /**
+   * \return true if a reception is in progress
+   */
+  bool IsRxing (void) const;
+  /**
+   * \return true if the access start is set by the EIFS which follows
+   *         a reception error rather than by the medium being busy
+   */
+  bool IsAccessStartEifs (void) const;
+  /**
+   * \return the access start as if there had been no reception
+   */
+  Time GetAccessStartWithoutRx (void) const;
+  /**
+   * \return the start of the last reception
+   */
+  Time GetRxStart (void) const;
+  /**
+   * \return the end of the last transmission
+   */
+  Time GetTxEnd (void) const;
+
+  /**
+   * \param duration expected duration of reception
+   */
+  void NotifyRxStartNow (Time duration);
+  /**
+   * Notify that the reception ended successfully.
+   */
+  void NotifyRxEndOkNow (void);
+  /**
+   * Notify that the reception ended with an error.
+   */
+  void NotifyRxEndErrorNow (void);
+  /**
+   * \param duration expected duration of transmission
+   */
+  void NotifyTxStartNow (Time duration);
+  /**
+   * \param duration expected duration of CCA busy period
+   */
+  void NotifyMaybeCcaBusyStartNow (Time duration);
+  /**
+   * \param duration expected duration of channel switching
+   */
+  void NotifySwitchingStartNow (Time duration);
+
+
+private:
+  /**
+   * Recompute the cached access start from the medium events.
+   */
+  void UpdateAccessStart (void);
+  /**
+   * Apply a transmission of the PHY which feeds this DcfMediumState.
+   *
+   * \param duration expected duration of transmission
+   */
+  void DoNotifyTxStart (Time duration);
+  /**
+   * Update the backoffs of all the DcfManagers, before a medium event.
+   */
+  void UpdateBackoffs (void);
+  /**
+   * Update the access grant start of all the DcfManagers, after a
+   * medium event.
+   */
+  void UpdateAccessGrantStarts (void);
+
+  uint32_t m_group;                    //!< medium group, 0 if not shared
+  EventId m_txStartEvent;              //!< the pending DoNotifyTxStart of a group
+  std::vector<DcfManager *> m_managers; //!< the awake DcfManagers which use this DcfMediumState
+  DcfManager *m_feeder;                //!< the DcfManager whose PHY feeds a group
+  Time m_eifsNoDifs;
+  Time m_lastRxStart;
+  Time m_lastRxDuration;
+  bool m_lastRxReceivedOk;
+  Time m_lastRxEnd;
+  Time m_lastTxStart;
+  Time m_lastTxDuration;
+  Time m_lastBusyStart;
+  Time m_lastBusyDuration;
+  Time m_lastSwitchingStart;
+  Time m_lastSwitchingDuration;
+  bool m_rxing;
+  Time m_accessStart;                  //!< cached value returned by GetAccessStart
+  bool m_accessStartEifs;              //!< cached value returned by IsAccessStartEifs
+  Time m_accessStartWithoutRx;         //!< cached value returned by GetAccessStartWithoutRx
+};
+
+
+/**
+ * \brief Manage a set of ns3::DcfState
+ * \ingroup wifi
+ *
+ * Handle a set of independent ns3::DcfState, each of which represents
+ * a single DCF within a MAC stack. Each ns3::DcfState has a priority
+ * implicitely associated with it (the priority is determined when the
+ * ns3::DcfState is added to the DcfManager: the first DcfState to be
+ * added gets the highest priority, the second, the second highest
+ * priority, and so on.) which is used to handle "internal" collisions.
+ * i.e., when two local DcfState are expected to get access to the
+ * medium at the same time, the highest priority local DcfState wins
+ * access to the medium and the other DcfState suffers a "internal"
+ * collision.
+ *
+ * Once added, the AIFSN and backoff counters of the DcfStates are stored
+ * by the DcfManager in contiguous arrays, indexed by priority, so that
+ * UpdateBackoff decrements all of them in a single branch-free loop.
+ *
+ * The DcfStates which requested access are indexed in a binary heap
+ * keyed by their backoff end, with the priority as tie-break, so that
+ * picking the next access grant or access timeout does not need a scan
+ * of all the registered DcfStates.
+ *
+ * The DcfManager also keeps per-manager contention statistics (grants,
+ * collisions, internal collisions and the expected backoff delay of each
+ * access timeout) which are exported as read-only attributes and trace
+ * sources. Updating them only increments plain counters.
+ *
+ * For offline debugging, the DcfManager can record its events (grants,
+ * collisions, backoff updates, NAV and PHY notifications, access
+ * timeouts) as fixed-size binary records in a ring buffer, enabled with
+ * the TraceRingSize attribute. WriteTraceRing dumps the ring and the
+ * dcf-trace-decode program turns the dump back into text.
+ *
+ * For regression checks, every call into the DcfManager (configuration,
+ * RequestAccess, PHY and MacLow notifications, backoff starts) and every
+ * notification of a DcfState can be recorded to a file with the
+ * RecordFilePrefix attribute. The dcf-replay program replays such a
+ * recording against a bare DcfManager and checks that the DcfStates are
+ * notified exactly as in the recorded run.
+ *
+ * The MAC creates its DcfManager with new and does not expose it, so
+ * the attribute defaults do not apply to it and it cannot be reached
+ * through a Config path: GetDcfManager returns the DcfManager of a PHY,
+ * whose attributes can then be set and whose trace sources can be
+ * connected directly.
+ */
+class DcfManager : public Object
+{
+  friend class DcfState;
+  friend class DcfMediumState;
+
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Get the most derived TypeId of this DcfManager.
+   *
+   * This is also valid for a DcfManager created with new, as the MAC does.
+   *
+   * \return the TypeId of DcfManager
+   */
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  DcfManager ();
+  virtual ~DcfManager ();
+
+  /**
+   * \param phy a PHY
+   *
+   * \return the DcfManager which listens to phy (see SetupPhyListener),
+   *         0 if none. The DcfManager is owned by the MAC, so the pointer
+   *         must not be used once the device is disposed.
+   */
+  static DcfManager * GetDcfManager (Ptr<WifiPhy> phy);
+
+  /**
+   * Number of bins of the expected backoff delay histogram. Bin i counts
+   * the access timeouts whose expected delay was in [2^i - 1, 2^(i+1) - 1)
+   * slots; the last bin also holds all the longer delays.
+   */
+  static const uint32_t BACKOFF_DELAY_BINS = 16;
+
+  /**
+   * TracedCallback signature for per-DcfState contention events.
+   *
+   * \param index the index of the DcfState in the order it was added
+   *        to this DcfManager (0 is the highest priority).
+   */
+  typedef void (* StateTracedCallback)(uint32_t index);
+
+  /**
+   * Contention statistics of a DcfState
+   */
+  struct StateStatistics
+  {
+    uint64_t grants;             //!< number of access grants
+    uint64_t collisions;         //!< number of accesses requested on a busy medium
+    uint64_t internalCollisions; //!< number of internal collisions lost
+    /**
+     * Histogram of the number of backoff slots drawn, with the bins of
+     * the expected backoff delay histogram (see BACKOFF_DELAY_BINS).
+     */
+    uint64_t backoffSlots[BACKOFF_DELAY_BINS];
+  };
+
+  /**
+   * TracedCallback signature for the periodic samples of the contention
+   * statistics of a DcfState.
+   *
+   * \param index the index of the DcfState
+   * \param stats the statistics of the DcfState since the last reset
+   */
+  typedef void (* StateStatisticsTracedCallback)(uint32_t index, const StateStatistics &stats);
+
+  /**
+   * What keeps access from being granted, as derived in
+   * UpdateAccessGrantStart. Ties go to the first cause in this order.
+   */
+  enum DeferralCause
+  {
+    DEFERRAL_BUSY,    //!< PHY rx, tx, CCA busy or channel switching
+    DEFERRAL_EIFS,    //!< EIFS after a reception error
+    DEFERRAL_NAV,     //!< virtual carrier sense
+    DEFERRAL_TIMEOUT  //!< ack or CTS timeout
+  };
+  /// Number of DeferralCause values
+  static const uint32_t DEFERRAL_CAUSES = 4;
+
+  /**
+   * TracedCallback signature for the periodic samples of the time
+   * deferred for each DeferralCause.
+   *
+   * \param busy the time deferred to DEFERRAL_BUSY since the last reset
+   * \param eifs the time deferred to DEFERRAL_EIFS since the last reset
+   * \param nav the time deferred to DEFERRAL_NAV since the last reset
+   * \param timeout the time deferred to DEFERRAL_TIMEOUT since the last reset
+   */
+  typedef void (* DeferralTracedCallback)(Time busy, Time eifs, Time nav, Time timeout);
+
+  /**
+   * Types of the records of the binary event ring.
+   */
+  enum TraceRecordType
+  {
+    TRACE_GRANT,                //!< access granted, arg: backoff slots left
+    TRACE_COLLISION,            //!< access requested on a busy medium
+    TRACE_INTERNAL_COLLISION,   //!< internal collision, arg: backoff slots left
+    TRACE_BACKOFF_START,        //!< backoff started, arg: number of slots
+    TRACE_BACKOFF_UPDATE,       //!< backoff slots decremented, arg: number of slots
+    TRACE_ACCESS_TIMEOUT_START, //!< access timeout needed, arg: expected backoff end (ticks)
+    TRACE_ACCESS_TIMEOUT,       //!< access timeout expired
+    TRACE_RX_START,             //!< rx start, arg: duration (ticks)
+    TRACE_RX_END_OK,            //!< rx end ok
+    TRACE_RX_END_ERROR,         //!< rx end error
+    TRACE_TX_START,             //!< tx start, arg: duration (ticks)
+    TRACE_BUSY_START,           //!< CCA busy start, arg: duration (ticks)
+    TRACE_SWITCHING_START,      //!< channel switching start, arg: duration (ticks)
+    TRACE_NAV_START,            //!< NAV start, arg: duration (ticks)
+    TRACE_NAV_RESET             //!< NAV reset, arg: duration (ticks)
+  };
+  /// Index of the records which are not about a single DcfState
+  static const uint32_t TRACE_ALL_STATES = 0xffffffff;
+  /// Magic number at the start of a binary event ring dump ("DCFT")
+  static const uint32_t TRACE_RING_MAGIC = 0x54464344;
+  /// Version of the binary event ring dump format
+  static const uint32_t TRACE_RING_VERSION = 1;
+
+  /**
+   * A record of the binary event ring.
+   */
+  struct TraceRecord
+  {
+    int64_t time;   //!< simulation time of the event, in ticks
+    int64_t arg;    //!< type-dependent argument
+    uint32_t index; //!< priority index of the DcfState, or TRACE_ALL_STATES
+    uint32_t type;  //!< a TraceRecordType
+  };
+  /**
+   * Header of a binary event ring dump, followed by the records,
+   * oldest first.
+   */
+  struct TraceRingHeader
+  {
+    uint32_t magic;      //!< TRACE_RING_MAGIC
+    uint32_t version;    //!< TRACE_RING_VERSION
+    uint32_t recordSize; //!< sizeof (TraceRecord)
+    uint32_t capacity;   //!< size of the ring
+    uint64_t nRecords;   //!< number of records written since the ring was set up
+  };
+
+  /**
+   * Types of the records of a call recording. The records up to
+   * CALL_CTS_TIMEOUT_RESET are calls into the DcfManager or its
+   * DcfStates, CALL_ACCESS_TIMEOUT is the expiry of the access timeout,
+   * and the others are notifications of a DcfState by the DcfManager.
+   */
+  enum CallRecordType
+  {
+    CALL_SET_SLOT,                  //!< SetSlot, arg: slot (ticks)
+    CALL_SET_SIFS,                  //!< SetSifs, arg: SIFS (ticks)
+    CALL_SET_EIFS_NO_DIFS,          //!< SetEifsNoDifs, arg: EIFS - DIFS (ticks)
+    CALL_ADD,                       //!< Add, arg: AIFSN | IsEdca << 32 | backoff slots << 33
+    CALL_SET_AIFSN,                 //!< DcfState::SetAifsn, arg: AIFSN
+    CALL_BACKOFF_START,             //!< DcfState::StartBackoffNow, arg: number of slots
+    CALL_REQUEST_ACCESS,            //!< RequestAccess
+    CALL_RX_START,                  //!< NotifyRxStartNow, arg: duration (ticks)
+    CALL_RX_END_OK,                 //!< NotifyRxEndOkNow
+    CALL_RX_END_ERROR,              //!< NotifyRxEndErrorNow
+    CALL_TX_START,                  //!< NotifyTxStartNow, arg: duration (ticks)
+    CALL_BUSY_START,                //!< NotifyMaybeCcaBusyStartNow, arg: duration (ticks)
+    CALL_SWITCHING_START,           //!< NotifySwitchingStartNow, arg: duration (ticks)
+    CALL_SLEEP,                     //!< NotifySleepNow
+    CALL_WAKEUP,                    //!< NotifyWakeupNow
+    CALL_NAV_RESET,                 //!< NotifyNavResetNow, arg: duration (ticks)
+    CALL_NAV_START,                 //!< NotifyNavStartNow, arg: duration (ticks)
+    CALL_ACK_TIMEOUT_START,         //!< NotifyAckTimeoutStartNow, arg: duration (ticks)
+    CALL_ACK_TIMEOUT_RESET,         //!< NotifyAckTimeoutResetNow
+    CALL_CTS_TIMEOUT_START,         //!< NotifyCtsTimeoutStartNow, arg: duration (ticks)
+    CALL_CTS_TIMEOUT_RESET,         //!< NotifyCtsTimeoutResetNow
+    CALL_ACCESS_TIMEOUT,            //!< the access timeout expired
+    CALL_NOTIFY_ACCESS_GRANTED,     //!< DcfState::NotifyAccessGranted
+    CALL_NOTIFY_COLLISION,          //!< DcfState::NotifyCollision
+    CALL_NOTIFY_INTERNAL_COLLISION, //!< DcfState::NotifyInternalCollision
+    CALL_NOTIFY_CHANNEL_SWITCHING,  //!< DcfState::NotifyChannelSwitching
+    CALL_NOTIFY_SLEEP,              //!< DcfState::NotifySleep
+    CALL_NOTIFY_WAKEUP              //!< DcfState::NotifyWakeUp
+  };
+  /// Magic number at the start of a call recording ("DCFR")
+  static const uint32_t CALL_RECORDING_MAGIC = 0x52464344;
+  /// Version of the call recording format
+  static const uint32_t CALL_RECORDING_VERSION = 1;
+
+  /**
+   * A record of a call recording.
+   *
+   * The depth is the number of recorded calls into the DcfManager which
+   * were in progress when the record was written: a call made by a
+   * DcfState from one of its notifications has the same depth as the
+   * notification, and the depth of the notification is one more than
+   * the depth of the call which triggered it.
+   */
+  struct CallRecord
+  {
+    int64_t time;   //!< simulation time of the call, in ticks
+    int64_t arg;    //!< type-dependent argument
+    uint32_t index; //!< priority index of the DcfState, or TRACE_ALL_STATES
+    uint16_t type;  //!< a CallRecordType
+    uint16_t depth; //!< nesting depth of the call
+  };
+  /**
+   * Header of a call recording, followed by the records in call order.
+   */
+  struct CallRecordingHeader
+  {
+    uint32_t magic;      //!< CALL_RECORDING_MAGIC
+    uint32_t version;    //!< CALL_RECORDING_VERSION
+    uint32_t recordSize; //!< sizeof (CallRecord)
+    uint32_t reserved;   //!< zero
+  };
+
+  /**
+   * Set up listener for Phy events.
+   *
+   * \param phy
+   */
+  void SetupPhyListener (Ptr<WifiPhy> phy);
+  /**
+   * Remove current registered listener for Phy events.
+   *
+   * \param phy
+   */
+  void RemovePhyListener (Ptr<WifiPhy> phy);
+  /**
+   * \param group the medium group of this DcfManager, 0 to track the
+   *        medium on its own (see DcfMediumState)
+   */
+  void SetMediumGroup (uint32_t group);
+  /**
+   * \return the medium group of this DcfManager, 0 if it tracks the
+   *         medium on its own
+   */
+  uint32_t GetMediumGroup (void) const;
+  /**
+   * Set up listener for MacLow events.
+   *
+   * \param low
+   */
+  void SetupLowListener (Ptr<MacLow> low);
+
+  /**
+   * \param slotTime the duration of a slot.
+   *
+   * It is a bad idea to call this method after RequestAccess or
+   * one of the Notify methods has been invoked.
+   */
+  void SetSlot (Time slotTime);
+  /**
+   * \param sifs the duration of a SIFS.
+   *
+   * It is a bad idea to call this method after RequestAccess or
+   * one of the Notify methods has been invoked.
+   */
+  void SetSifs (Time sifs);
+  /**
+   * \param eifsNoDifs the duration of a EIFS minus the duration of DIFS.
+   *
+   * It is a bad idea to call this method after RequestAccess or
+   * one of the Notify methods has been invoked.
+   */
+  void SetEifsNoDifs (Time eifsNoDifs);
+
+  /**
+   * \return value set previously using SetEifsNoDifs.
+   */
+  Time GetEifsNoDifs () const;
+
+  /**
+   * \param dcf a new DcfState.
+   *
+   * The DcfManager does not take ownership of this pointer so, the callee
+   * must make sure that the DcfState pointer will stay valid as long
+   * as the DcfManager is valid. Note that the order in which DcfState
+   * objects are added to a DcfManager matters: the first DcfState added
+   * has the highest priority, the second DcfState added, has the second
+   * highest priority, etc.
+   */
+  void Add (DcfState *dcf);
+
+  /**
+   * \param state a DcfState
+   *
+   * Notify the DcfManager that a specific DcfState needs access to the
+   * medium. The DcfManager is then responsible for starting an access
+   * timer and, invoking DcfState::DoNotifyAccessGranted when the access
+   * is granted if it ever gets granted.
+   */
+  void RequestAccess (DcfState *state);
+
+  /**
+   * \param duration expected duration of reception
+   *
+   * Notify the DCF that a packet reception started
+   * for the expected duration.
+   */
+  void NotifyRxStartNow (Time duration);
+  /**
+   * Notify the DCF that a packet reception was just
+   * completed successfully.
+   */
+  void NotifyRxEndOkNow (void);
+  /**
+   * Notify the DCF that a packet reception was just
+   * completed unsuccessfully.
+   */
+  void NotifyRxEndErrorNow (void);
+  /**
+   * \param duration expected duration of transmission
+   *
+   * Notify the DCF that a packet transmission was
+   * just started and is expected to last for the specified
+   * duration.
+   */
+  void NotifyTxStartNow (Time duration);
+  /**
+   * \param duration expected duration of cca busy period
+   *
+   * Notify the DCF that a CCA busy period has just started.
+   */
+  void NotifyMaybeCcaBusyStartNow (Time duration);
+  /**
+   * \param duration expected duration of channel switching period
+   *
+   * Notify the DCF that a channel switching period has just started.
+   * During switching state, new packets can be enqueued in DcaTxop/EdcaTxop
+   * but they won't access to the medium until the end of the channel switching.
+   */
+  void NotifySwitchingStartNow (Time duration);
+  /**
+   * Notify the DCF that the device has been put in sleep mode.
+   */
+  void NotifySleepNow (void);
+  /**
+   * Notify the DCF that the device has been resumed from sleep mode.
+   */
+  void NotifyWakeupNow (void);
+  /**
+   * \param duration the value of the received NAV.
+   *
+   * Called at end of rx
+   */
+  void NotifyNavResetNow (Time duration);
+  /**
+   * \param duration the value of the received NAV.
+   *
+   * Called at end of rx
+   */
+  void NotifyNavStartNow (Time duration);
+  /**
+   * Notify that ACK timer has started for the given duration.
+   *
+   * \param duration
+   */
+  void NotifyAckTimeoutStartNow (Time duration);
+  /**
+   * Notify that ACK timer has resetted.
+   */
+  void NotifyAckTimeoutResetNow ();
+  /**
+   * Notify that CTS timer has started for the given duration.
+   *
+   * \param duration
+   */
+  void NotifyCtsTimeoutStartNow (Time duration);
+  /**
+   * Notify that CTS timer has resetted.
+   */
+  void NotifyCtsTimeoutResetNow ();
+
+  /**
+   * \return the number of times access was granted to one of the DcfStates.
+   */
+  uint64_t GetGrants (void) const;
+  /**
+   * \return the number of times access was requested while the medium
+   *         was busy and the DcfState had no backoff left.
+   */
+  uint64_t GetCollisions (void) const;
+  /**
+   * \return the number of internal collisions between DcfStates
+   *         of this DcfManager.
+   */
+  uint64_t GetInternalCollisions (void) const;
+  /**
+   * \return the sum of the expected backoff delays computed every
+   *         time the access timeout is (re)started.
+   */
+  Time GetTotalBackoffDelay (void) const;
+  /**
+   * \param bin the histogram bin, smaller than BACKOFF_DELAY_BINS
+   *
+   * \return the number of expected backoff delays which fell into bin
+   */
+  uint64_t GetBackoffDelayCount (uint32_t bin) const;
+  /**
+   * \param index the index of a DcfState of this DcfManager
+   *
+   * \return the contention statistics of the DcfState
+   */
+  const StateStatistics & GetStateStatistics (uint32_t index) const;
+  /**
+   * \param cause a cause of deferral
+   *
+   * \return the time during which access could not be granted because
+   *         of cause, not counting the SIFS which follows
+   */
+  Time GetDeferral (DeferralCause cause) const;
+  /**
+   * Reset all the contention statistics to zero.
+   */
+  void ResetStatistics (void);
+  /**
+   * \param interval the interval between two samples of the
+   *        StateStatistics and Deferrals trace sources, 0 to disable them
+   */
+  void SetSampleInterval (Time interval);
+  /**
+   * \return the interval between two samples of the StateStatistics and
+   *         Deferrals trace sources, 0 if they are disabled
+   */
+  Time GetSampleInterval (void) const;
+
+  /**
+   * \param size the number of records kept in the binary event ring.
+   *
+   * A size of zero disables the ring. Any record already in the ring
+   * is dropped.
+   */
+  void SetTraceRingSize (uint32_t size);
+  /**
+   * \return the number of records kept in the binary event ring.
+   */
+  uint32_t GetTraceRingSize (void) const;
+  /**
+   * Write a TraceRingHeader followed by the records of the binary
+   * event ring, oldest first.
+   *
+   * \param os the output stream, opened in binary mode
+   */
+  void WriteTraceRing (std::ostream &os) const;
+  /**
+   * \param type a TraceRecordType
+   * \return a printable name for type
+   */
+  static const char * GetTraceRecordTypeName (uint32_t type);
+
+  /**
+   * \param prefix the prefix of the call recording file, or an empty
+   *        string to stop recording.
+   *
+   * Record all the following calls to <prefix>-<n>.dcfr, where n counts
+   * the recordings started in this process. The recording starts with
+   * the current slot, SIFS, EIFS and DcfStates, so it should be started
+   * before the DcfManager is first notified of PHY or MacLow events.
+   */
+  void SetRecordFilePrefix (std::string prefix);
+  /**
+   * \return the prefix of the call recording file, empty if not recording
+   */
+  std::string GetRecordFilePrefix (void) const;
+  /**
+   * \param type a CallRecordType
+   * \return a printable name for type
+   */
+  static const char * GetCallRecordTypeName (uint32_t type);
+
+
+private:
+  /**
+   * Stop the access timeout and the samples, and leave the medium group,
+   * so that a disposed DcfManager keeps no group alive.
+   */
+  virtual void DoDispose (void);
+  /**
+   * Update backoff slots for all DcfStates. This is a no-op unless
+   * some DcfState has backoff slots left and the AIFS of some
+   * DcfState may have elapsed.
+   */
+  void UpdateBackoff (void);
+  /**
+   * Return the most recent time.
+   *
+   * \param a
+   * \param b
+   *
+   * \return the most recent time
+   */
+  Time MostRecent (Time a, Time b) const;
+  /**
+   * Return the most recent time.
+   *
+   * \param a
+   * \param b
+   * \param c
+   *
+   * \return the most recent time
+   */
+  Time MostRecent (Time a, Time b, Time c) const;
+  /**
+   * Return the most recent time.
+   *
+   * \param a
+   * \param b
+   * \param c
+   * \param d
+   *
+   * \return the most recent time
+   */
+  Time MostRecent (Time a, Time b, Time c, Time d) const;
+  /**
+   * Return the most recent time.
+   *
+   * \param a
+   * \param b
+   * \param c
+   * \param d
+   * \param e
+   * \param f
+   *
+   * \return the most recent time
+   */
+  Time MostRecent (Time a, Time b, Time c, Time d, Time e, Time f) const;
+  /**
+   * Return the most recent time.
+   *
+   * \param a
+   * \param b
+   * \param c
+   * \param d
+   * \param e
+   * \param f
+   * \param g
+   *
+   * \return the most recent time
+   */
+  Time MostRecent (Time a, Time b, Time c, Time d, Time e, Time f, Time g) const;
+  /**
+   * Access will never be granted to the medium _before_
+   * the time returned by this method.
+   *
+   * \returns the absolute time at which access could start to be granted
+   */
+  Time GetAccessGrantStart (void) const;
+  /**
+   * Recompute the cached access grant start from the last
+   * rx/busy/tx/nav/ack-timeout/cts-timeout/switching events.
+   * Must be called whenever one of these changes.
+   */
+  void UpdateAccessGrantStart (void);
+  /**
+   * Apply the start of a channel switching to the NAV, timeouts and
+   * DcfStates of this DcfManager.
+   *
+   * \param duration expected duration of channel switching
+   */
+  void DoNotifySwitchingStart (Time duration);
+  /**
+   * \return true if the reception of the medium group started during our
+   *         own transmission, so that our own PHY would not have seen it
+   */
+  bool IsOwnReception (void) const;
+  /**
+   * Add the time deferred since the last call to the current cause of
+   * deferral.
+   */
+  void AccountDeferral (void);
+  /**
+   * Fire the StateStatistics and Deferrals trace sources, and schedule
+   * the next sample.
+   */
+  void Sample (void);
+  /**
+   * \param slots a number of slots
+   *
+   * \return the bin of slots in the backoff histograms
+   */
+  static uint32_t GetBackoffBin (uint64_t slots);
+  /**
+   * Return the time when the backoff procedure
+   * started for the given DcfState.
+   *
+   * \param state
+   *
+   * \return the time when the backoff procedure started
+   */
+  Time GetBackoffStartFor (DcfState *state);
+  /**
+   * Return the time when the backoff procedure
+   * ended (or will ended) for the given DcfState.
+   *
+   * \param state
+   *
+   * \return the time when the backoff procedure ended (or will ended)
+   */
+  Time GetBackoffEndFor (DcfState *state);
+  /**
+   * Restart the access timeout if needed.
+   */
+  void DoRestartAccessTimeoutIfNeeded (void);
+  /**
+   * Called when access timeout should occur
+   * (e.g. backoff procedure expired).
+   *
+   * If a single DcfState requested access and nothing changed on
+   * the medium since the timeout was scheduled for its backoff end,
+   * access is granted to it directly.
+   */
+  void AccessTimeout (void);
+  /**
+   * Schedule AccessTimeout with an AccessTimeoutEvent, whose memory is
+   * reused from the events which expired or were removed.
+   *
+   * \param delay the delay before AccessTimeout is called
+   */
+  void ScheduleAccessTimeout (Time delay);
+  /**
+   * Grant access to DCF
+   */
+  void DoGrantAccess (void);
+  /**
+   * Check if the device is busy sending or receiving,
+   * or NAV busy.
+   *
+   * \return true if the device is busy,
+   *         false otherwise
+   */
+  bool IsBusy (void) const;
+
+  /**
+   * Entry of the backoff index. An entry is stale once a newer
+   * entry has been pushed for the same DcfState, or once this
+   * DcfState does not request access anymore.
+   */
+  struct BackoffIndexEntry
+  {
+    Time backoffEnd;  //!< backoff end of the DcfState when the entry was pushed
+    uint32_t index;   //!< priority index of the DcfState
+    uint32_t version; //!< version of the entry for this DcfState
+
+    /**
+     * Heap ordering: an entry is smaller if it expires later or,
+     * for equal backoff ends, if it has a lower priority.
+     *
+     * \param o the other entry
+     * \return true if this entry is smaller than o
+     */
+    bool operator< (const BackoffIndexEntry &o) const;
+  };
+  /**
+   * \param a a DcfState
+   * \param b another DcfState
+   * \return true if a was added to the DcfManager before b
+   */
+  static bool HasHigherPriority (const DcfState *a, const DcfState *b);
+  /**
+   * Push the current backoff end of the given DcfState in the backoff
+   * index. Any previous entry for this DcfState becomes stale.
+   *
+   * \param state the DcfState
+   */
+  void PushBackoffIndexEntry (DcfState *state);
+  /**
+   * Remove the entry with the earliest backoff end from the backoff index.
+   *
+   * \return the removed entry
+   */
+  BackoffIndexEntry PopBackoffIndexEntry (void);
+  /**
+   * \param entry an entry of the backoff index
+   * \return true if the entry is not stale
+   */
+  bool IsLiveBackoffIndexEntry (const BackoffIndexEntry &entry) const;
+  /**
+   * Rebuild the backoff index from the DcfStates which request access if
+   * backoff ends may have moved backward since the last rebuild, or if
+   * stale entries make up most of the index.
+   */
+  void RefreshBackoffIndex (void);
+  /**
+   * Append a record to the binary event ring, if it is enabled.
+   *
+   * \param type the type of the record
+   * \param index the priority index of the DcfState, or TRACE_ALL_STATES
+   * \param arg the type-dependent argument
+   */
+  void RecordTrace (TraceRecordType type, uint32_t index, int64_t arg);
+  /**
+   * Append a record to the call recording, if it is enabled.
+   *
+   * \param type the type of the record
+   * \param index the priority index of the DcfState, or TRACE_ALL_STATES
+   * \param arg the type-dependent argument
+   */
+  void RecordCall (CallRecordType type, uint32_t index, int64_t arg);
+  /**
+   * \param aifsn the AIFSN of a DcfState
+   * \param edca whether the DcfState follows the EDCA backoff rules
+   * \param backoffSlots the backoff slots left of the DcfState
+   * \return the argument of the CALL_ADD record of the DcfState
+   */
+  static int64_t GetAddRecordArg (uint32_t aifsn, bool edca, uint32_t backoffSlots);
+  /**
+   * Records a call into the DcfManager and counts it as in progress
+   * until the end of the enclosing scope.
+   */
+  class CallScope;
+  /**
+   * Event which calls AccessTimeout. Its memory is recycled through a
+   * free list, so that scheduling the access timeout does not allocate.
+   */
+  class AccessTimeoutEvent;
+
+  /**
+   * typedef for a vector of DcfStates
+   */
+  typedef std::vector<DcfState *> States;
+
+  States m_states;
+  std::vector<uint32_t> m_backoffSlots;  //!< backoff slots left, per DcfState
+  std::vector<int64_t> m_backoffStarts;  //!< backoff start or last update, in simulator ticks, per DcfState
+  std::vector<uint32_t> m_aifsns;        //!< AIFSN, per DcfState
+  std::vector<uint32_t> m_edcaSlots;     //!< extra slot decremented at the end of AIFS (1 for EDCA, 0 for DCA), per DcfState
+  uint32_t m_nActiveBackoffs;            //!< number of DcfStates with backoff slots left
+  Time m_lastAckTimeoutEnd;
+  Time m_lastCtsTimeoutEnd;
+  Time m_lastNavStart;
+  Time m_lastNavDuration;
+  Ptr<DcfMediumState> m_medium; //!< rx, CCA busy, tx and switching events
+  uint32_t m_mediumIndex;       //!< index in the members of m_medium, DcfMediumState::NO_MEDIUM_INDEX if not a member
+  Time m_ownTxStart;            //!< start of our last transmission, only tracked in a medium group
+  Time m_ownTxEnd;              //!< end of our last transmission, only tracked in a medium group
+  bool m_sleeping;
+  Time m_accessGrantStart; //!< cached value returned by GetAccessGrantStart
+  std::vector<BackoffIndexEntry> m_backoffIndex; //!< heap of the DcfStates which request access
+  std::vector<uint32_t> m_backoffIndexVersions;  //!< version of the live entry of each DcfState
+  bool m_backoffIndexDirty; //!< whether the backoff index must be rebuilt
+  States m_expiredStates;   //!< scratch stack of the DcfStates whose backoff expired, kept to avoid reallocations
+  uint32_t m_nAccessRequested; //!< number of DcfStates which request access
+  DcfState *m_fastGrantState;  //!< single contender granted by the next access timeout, if the medium stays unchanged
+  Time m_fastGrantEnd;         //!< backoff end of m_fastGrantState
+  Time m_eifsNoDifs;
+  EventId m_accessTimeout; //!< fires AccessTimeout when the earliest backoff ends
+  int64_t m_slot;        //!< slot duration, in simulator ticks
+  Time m_sifs;
+  PhyListener* m_phyListener;
+  LowDcfListener* m_lowListener;
+
+  uint64_t m_nGrants;             //!< number of access grants
+  uint64_t m_nCollisions;         //!< number of collisions
+  uint64_t m_nInternalCollisions; //!< number of internal collisions
+  Time m_totalBackoffDelay;       //!< sum of the expected backoff delays
+  uint64_t m_backoffDelayHistogram[BACKOFF_DELAY_BINS]; //!< expected backoff delay histogram, in slots
+  std::vector<StateStatistics> m_stateStatistics; //!< contention statistics of each DcfState
+  Time m_deferrals[DEFERRAL_CAUSES]; //!< time deferred for each cause
+  Time m_deferralCheckpoint;     //!< time up to which the deferrals are accounted
+  Time m_deferralEnd;            //!< end of the current deferral, without SIFS
+  DeferralCause m_deferralCause; //!< cause of the current deferral
+  Time m_sampleInterval;         //!< interval between two samples, 0 if disabled
+  Timer m_sampleTimer;           //!< fires Sample
+
+  TracedCallback<uint32_t> m_accessGrantedTrace;     //!< fired when a DcfState is granted access
+  TracedCallback<uint32_t> m_collisionTrace;         //!< fired when a DcfState suffers a collision
+  TracedCallback<uint32_t> m_internalCollisionTrace; //!< fired when a DcfState suffers an internal collision
+  TracedCallback<Time> m_backoffDelayTrace;          //!< fired with the expected backoff delay of each access timeout
+  TracedCallback<uint32_t, const StateStatistics &> m_stateStatisticsTrace; //!< sampled statistics of each DcfState
+  TracedCallback<Time, Time, Time, Time> m_deferralsTrace;                 //!< sampled deferral times
+
+  std::vector<TraceRecord> m_traceRing; //!< binary event ring, empty if disabled
+  uint32_t m_traceRingHead;             //!< position of the next record in the ring
+  uint64_t m_nTraceRecords;             //!< number of records written since the ring was set up
+
+  std::string m_recordFilePrefix; //!< prefix of the call recording file
+  std::ostream *m_recording;      //!< call recording, 0 if disabled
+  uint16_t m_recordDepth;         //!< number of recorded calls in progress
+  TracedCallback<> m_accessTimeoutTrace; //!< fired when the access timeout expires
+};
+
+} //namespace ns3
+
+#endif /* DCF_MANAGER_H */
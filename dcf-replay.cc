@@ -0,0 +1,496 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/dcf-manager.h"
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Replay of a DcfManager call recording (see the RecordFilePrefix
+// attribute of DcfManager) against a bare DcfManager, with stub
+// DcfStates and no PHY, channel, MAC or application object.
+//
+// Example: ./waf --run "dcf-replay --input=dcf-0.dcfr"
+//
+// The calls into the DcfManager are replayed at their recorded time,
+// order and nesting. Every notification of a DcfState and every expiry of the
+// access timeout must match the recording: the program stops at the
+// first divergence, prints it and exits with status 1. It can also be
+// used as a workload for the access logic, with --repeat to replay the
+// recording several times.
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("DcfReplay");
+
+class DcfReplayer;
+
+class ReplayDcfState : public DcfState
+{
+public:
+  ReplayDcfState (DcfReplayer *replayer, bool edca);
+
+
+private:
+  virtual bool IsEdca (void) const;
+  virtual void DoNotifyAccessGranted (void);
+  virtual void DoNotifyInternalCollision (void);
+  virtual void DoNotifyCollision (void);
+  virtual void DoNotifyChannelSwitching (void);
+  virtual void DoNotifySleep (void);
+  virtual void DoNotifyWakeUp (void);
+
+  DcfReplayer *m_replayer;
+  bool m_edca;
+};
+
+class DcfReplayer
+{
+public:
+  DcfReplayer ();
+  ~DcfReplayer ();
+
+  bool Load (std::string filename);
+  //replay the whole recording, return true if it matched
+  bool Replay (void);
+  uint64_t GetNRecords (void) const;
+
+  void Notify (ReplayDcfState *state, DcfManager::CallRecordType type);
+
+
+private:
+  static bool IsCall (uint16_t type);
+  void Fire (uint64_t target);
+  void Resume (void);
+  bool IsAccessTimeoutPending (void) const;
+  void Execute (const DcfManager::CallRecord &record);
+  void AccessTimeout (void);
+  void Diverge (std::string what);
+
+  std::vector<DcfManager::CallRecord> m_records;
+  uint64_t m_next;      //!< next record to replay or check
+  Ptr<DcfManager> m_manager;
+  std::vector<ReplayDcfState *> m_states;
+  std::deque<uint64_t> m_deferred; //!< top-level calls waiting for an access timeout recorded before them
+  bool m_diverged;
+};
+
+ReplayDcfState::ReplayDcfState (DcfReplayer *replayer, bool edca)
+  : m_replayer (replayer),
+    m_edca (edca)
+{
+}
+
+bool
+ReplayDcfState::IsEdca (void) const
+{
+  return m_edca;
+}
+
+void
+ReplayDcfState::DoNotifyAccessGranted (void)
+{
+  m_replayer->Notify (this, DcfManager::CALL_NOTIFY_ACCESS_GRANTED);
+}
+
+void
+ReplayDcfState::DoNotifyInternalCollision (void)
+{
+  m_replayer->Notify (this, DcfManager::CALL_NOTIFY_INTERNAL_COLLISION);
+}
+
+void
+ReplayDcfState::DoNotifyCollision (void)
+{
+  m_replayer->Notify (this, DcfManager::CALL_NOTIFY_COLLISION);
+}
+
+void
+ReplayDcfState::DoNotifyChannelSwitching (void)
+{
+  m_replayer->Notify (this, DcfManager::CALL_NOTIFY_CHANNEL_SWITCHING);
+}
+
+void
+ReplayDcfState::DoNotifySleep (void)
+{
+  m_replayer->Notify (this, DcfManager::CALL_NOTIFY_SLEEP);
+}
+
+void
+ReplayDcfState::DoNotifyWakeUp (void)
+{
+  m_replayer->Notify (this, DcfManager::CALL_NOTIFY_WAKEUP);
+}
+
+DcfReplayer::DcfReplayer ()
+  : m_next (0),
+    m_diverged (false)
+{
+}
+
+DcfReplayer::~DcfReplayer ()
+{
+  for (std::vector<ReplayDcfState *>::const_iterator i = m_states.begin (); i != m_states.end (); i++)
+    {
+      delete *i;
+    }
+}
+
+bool
+DcfReplayer::Load (std::string filename)
+{
+  std::ifstream is (filename.c_str (), std::ios::binary);
+  if (!is)
+    {
+      std::cerr << "cannot open " << filename << "\n";
+      return false;
+    }
+  DcfManager::CallRecordingHeader header;
+  if (!is.read (reinterpret_cast<char *> (&header), sizeof (header))
+      || header.magic != DcfManager::CALL_RECORDING_MAGIC)
+    {
+      std::cerr << filename << " is not a DcfManager call recording\n";
+      return false;
+    }
+  if (header.version != DcfManager::CALL_RECORDING_VERSION
+      || header.recordSize != sizeof (DcfManager::CallRecord))
+    {
+      std::cerr << filename << ": unsupported version " << header.version
+                << " or record size " << header.recordSize << "\n";
+      return false;
+    }
+  DcfManager::CallRecord record;
+  while (is.read (reinterpret_cast<char *> (&record), sizeof (record)))
+    {
+      m_records.push_back (record);
+    }
+  return true;
+}
+
+uint64_t
+DcfReplayer::GetNRecords (void) const
+{
+  return m_records.size ();
+}
+
+bool
+DcfReplayer::IsCall (uint16_t type)
+{
+  return type < DcfManager::CALL_ACCESS_TIMEOUT;
+}
+
+bool
+DcfReplayer::Replay (void)
+{
+  for (std::vector<ReplayDcfState *>::const_iterator i = m_states.begin (); i != m_states.end (); i++)
+    {
+      delete *i;
+    }
+  m_states.clear ();
+  m_deferred.clear ();
+  m_next = 0;
+  m_diverged = false;
+  m_manager = CreateObject<DcfManager> ();
+  m_manager->TraceConnectWithoutContext ("AccessTimeout", MakeCallback (&DcfReplayer::AccessTimeout, this));
+  if (!m_records.empty ())
+    {
+      //access timeouts which expire after the last record were not recorded
+      Simulator::Stop (TimeStep (m_records.back ().time + 1) - Simulator::Now ());
+    }
+  /**
+   * All the top-level calls are scheduled up front, so that they come
+   * before any access timeout which the DcfManager schedules for the
+   * same time. When an access timeout was recorded first, Fire defers
+   * the call until the DcfManager handled the access timeout, so the
+   * calls and the access timeouts run exactly in the recorded order.
+   */
+  for (uint64_t i = 0; i < m_records.size (); i++)
+    {
+      if (m_records[i].depth == 0 && IsCall (m_records[i].type))
+        {
+          Simulator::Schedule (TimeStep (m_records[i].time), &DcfReplayer::Fire, this, i);
+        }
+    }
+  Simulator::Run ();
+  Simulator::Destroy ();
+  if (!m_diverged && m_next != m_records.size ())
+    {
+      Diverge ("recording not exhausted");
+    }
+  m_manager = 0;
+  return !m_diverged;
+}
+
+bool
+DcfReplayer::IsAccessTimeoutPending (void) const
+{
+  const DcfManager::CallRecord &pending = m_records[m_next];
+  return pending.type == DcfManager::CALL_ACCESS_TIMEOUT
+         && TimeStep (pending.time) == Simulator::Now ();
+}
+
+void
+DcfReplayer::Fire (uint64_t target)
+{
+  if (m_diverged)
+    {
+      return;
+    }
+  if (!m_deferred.empty ())
+    {
+      //keep the recorded order of the calls made at the same time
+      m_deferred.push_back (target);
+      return;
+    }
+  if (m_next < target)
+    {
+      if (IsAccessTimeoutPending ())
+        {
+          //an access timeout which expires now was recorded before this call
+          m_deferred.push_back (target);
+          return;
+        }
+      Diverge (std::string ("missing ") + DcfManager::GetCallRecordTypeName (m_records[m_next].type));
+      return;
+    }
+  const DcfManager::CallRecord &record = m_records[m_next++];
+  Execute (record);
+}
+
+void
+DcfReplayer::Resume (void)
+{
+  while (!m_diverged && !m_deferred.empty ())
+    {
+      if (m_next < m_deferred.front ())
+        {
+          if (!IsAccessTimeoutPending ())
+            {
+              Diverge (std::string ("missing ") + DcfManager::GetCallRecordTypeName (m_records[m_next].type));
+            }
+          //else wait for the next access timeout
+          return;
+        }
+      m_deferred.pop_front ();
+      const DcfManager::CallRecord &record = m_records[m_next++];
+      Execute (record);
+    }
+}
+
+void
+DcfReplayer::Execute (const DcfManager::CallRecord &record)
+{
+  if (record.type != DcfManager::CALL_ADD
+      && record.index != DcfManager::TRACE_ALL_STATES
+      && record.index >= m_states.size ())
+    {
+      Diverge ("unknown DcfState");
+      return;
+    }
+  Time duration = TimeStep (record.arg);
+  switch (record.type)
+    {
+    case DcfManager::CALL_SET_SLOT:
+      m_manager->SetSlot (duration);
+      break;
+    case DcfManager::CALL_SET_SIFS:
+      m_manager->SetSifs (duration);
+      break;
+    case DcfManager::CALL_SET_EIFS_NO_DIFS:
+      m_manager->SetEifsNoDifs (duration);
+      break;
+    case DcfManager::CALL_ADD:
+      {
+        ReplayDcfState *state = new ReplayDcfState (this, (record.arg >> 32) & 1);
+        state->SetAifsn (record.arg & 0xffffffff);
+        state->StartBackoffNow (record.arg >> 33);
+        m_states.push_back (state);
+        m_manager->Add (state);
+        break;
+      }
+    case DcfManager::CALL_SET_AIFSN:
+      m_states[record.index]->SetAifsn (record.arg);
+      break;
+    case DcfManager::CALL_BACKOFF_START:
+      m_states[record.index]->StartBackoffNow (record.arg);
+      break;
+    case DcfManager::CALL_REQUEST_ACCESS:
+      m_manager->RequestAccess (m_states[record.index]);
+      break;
+    case DcfManager::CALL_RX_START:
+      m_manager->NotifyRxStartNow (duration);
+      break;
+    case DcfManager::CALL_RX_END_OK:
+      m_manager->NotifyRxEndOkNow ();
+      break;
+    case DcfManager::CALL_RX_END_ERROR:
+      m_manager->NotifyRxEndErrorNow ();
+      break;
+    case DcfManager::CALL_TX_START:
+      m_manager->NotifyTxStartNow (duration);
+      break;
+    case DcfManager::CALL_BUSY_START:
+      m_manager->NotifyMaybeCcaBusyStartNow (duration);
+      break;
+    case DcfManager::CALL_SWITCHING_START:
+      m_manager->NotifySwitchingStartNow (duration);
+      break;
+    case DcfManager::CALL_SLEEP:
+      m_manager->NotifySleepNow ();
+      break;
+    case DcfManager::CALL_WAKEUP:
+      m_manager->NotifyWakeupNow ();
+      break;
+    case DcfManager::CALL_NAV_RESET:
+      m_manager->NotifyNavResetNow (duration);
+      break;
+    case DcfManager::CALL_NAV_START:
+      m_manager->NotifyNavStartNow (duration);
+      break;
+    case DcfManager::CALL_ACK_TIMEOUT_START:
+      m_manager->NotifyAckTimeoutStartNow (duration);
+      break;
+    case DcfManager::CALL_ACK_TIMEOUT_RESET:
+      m_manager->NotifyAckTimeoutResetNow ();
+      break;
+    case DcfManager::CALL_CTS_TIMEOUT_START:
+      m_manager->NotifyCtsTimeoutStartNow (duration);
+      break;
+    case DcfManager::CALL_CTS_TIMEOUT_RESET:
+      m_manager->NotifyCtsTimeoutResetNow ();
+      break;
+    default:
+      Diverge ("unexpected record");
+      break;
+    }
+}
+
+void
+DcfReplayer::Notify (ReplayDcfState *state, DcfManager::CallRecordType type)
+{
+  if (m_diverged || m_next >= m_records.size ())
+    {
+      return;
+    }
+  const DcfManager::CallRecord &record = m_records[m_next];
+  if (record.type != type
+      || TimeStep (record.time) != Simulator::Now ()
+      || record.index >= m_states.size ()
+      || m_states[record.index] != state)
+    {
+      Diverge (std::string ("unexpected ") + DcfManager::GetCallRecordTypeName (type));
+      return;
+    }
+  m_next++;
+  //the calls which follow the notification at the same depth were made
+  //by the DcfState from the notification
+  uint16_t depth = record.depth;
+  while (!m_diverged
+         && m_next < m_records.size ()
+         && m_records[m_next].depth == depth
+         && IsCall (m_records[m_next].type))
+    {
+      Execute (m_records[m_next++]);
+    }
+}
+
+void
+DcfReplayer::AccessTimeout (void)
+{
+  if (m_diverged || m_next >= m_records.size ())
+    {
+      return;
+    }
+  const DcfManager::CallRecord &record = m_records[m_next];
+  if (record.type != DcfManager::CALL_ACCESS_TIMEOUT
+      || record.depth != 0
+      || TimeStep (record.time) != Simulator::Now ())
+    {
+      Diverge ("unexpected access-timeout");
+      return;
+    }
+  m_next++;
+  if (!m_deferred.empty ())
+    {
+      /**
+       * Run the deferred calls once the DcfManager handled this access
+       * timeout, and before any access timeout it schedules now.
+       */
+      Simulator::ScheduleNow (&DcfReplayer::Resume, this);
+    }
+}
+
+void
+DcfReplayer::Diverge (std::string what)
+{
+  m_diverged = true;
+  std::cout << "divergence at " << Simulator::Now ().GetTimeStep () << ": " << what;
+  if (m_next < m_records.size ())
+    {
+      const DcfManager::CallRecord &record = m_records[m_next];
+      std::cout << ", record " << m_next << " is " << record.time << " "
+                << DcfManager::GetCallRecordTypeName (record.type) << " ";
+      if (record.index == DcfManager::TRACE_ALL_STATES)
+        {
+          std::cout << "all";
+        }
+      else
+        {
+          std::cout << record.index;
+        }
+      std::cout << " " << record.arg << " depth " << record.depth;
+    }
+  std::cout << "\n";
+  Simulator::Stop ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string input = "dcf-0.dcfr";
+  uint32_t repeat = 1;
+
+  CommandLine cmd;
+  cmd.AddValue ("input", "Call recording to replay", input);
+  cmd.AddValue ("repeat", "Number of times the recording is replayed", repeat);
+  cmd.Parse (argc, argv);
+
+  DcfReplayer replayer;
+  if (!replayer.Load (input))
+    {
+      return 1;
+    }
+
+  SystemWallClockMs clock;
+  clock.Start ();
+  for (uint32_t i = 0; i < repeat; i++)
+    {
+      if (!replayer.Replay ())
+        {
+          return 1;
+        }
+    }
+  int64_t elapsedMs = clock.End ();
+
+  std::cout << "replayed " << replayer.GetNRecords () << " records "
+            << repeat << " times without divergence in " << elapsedMs << " ms\n";
+
+  return 0;
+}
@@ -0,0 +1,85 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/dcf-manager.h"
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Offline decoder for the binary event ring of a DcfManager
+// (see DcfManager::SetTraceRingSize and DcfManager::WriteTraceRing).
+//
+// Example: ./waf --run "dcf-trace-decode --input=dcf-trace.bin"
+//
+// Each record is printed on one line as:
+//   <time in ticks> <record type> <dcf index or "all"> <argument>
+
+using namespace ns3;
+
+int
+main (int argc, char *argv[])
+{
+  std::string input = "dcf-trace.bin";
+
+  CommandLine cmd;
+  cmd.AddValue ("input", "Binary event ring dump to decode", input);
+  cmd.Parse (argc, argv);
+
+  std::ifstream is (input.c_str (), std::ios::binary);
+  if (!is)
+    {
+      std::cerr << "cannot open " << input << "\n";
+      return 1;
+    }
+
+  DcfManager::TraceRingHeader header;
+  if (!is.read (reinterpret_cast<char *> (&header), sizeof (header))
+      || header.magic != DcfManager::TRACE_RING_MAGIC)
+    {
+      std::cerr << input << " is not a DcfManager event ring dump\n";
+      return 1;
+    }
+  if (header.version != DcfManager::TRACE_RING_VERSION
+      || header.recordSize != sizeof (DcfManager::TraceRecord))
+    {
+      std::cerr << input << ": unsupported version " << header.version
+                << " or record size " << header.recordSize << "\n";
+      return 1;
+    }
+
+  uint64_t nKept = std::min<uint64_t> (header.nRecords, header.capacity);
+  std::cout << "# " << header.nRecords << " records written, "
+            << nKept << " kept (ring size " << header.capacity << ")\n";
+
+  DcfManager::TraceRecord record;
+  while (is.read (reinterpret_cast<char *> (&record), sizeof (record)))
+    {
+      std::cout << record.time << " "
+                << DcfManager::GetTraceRecordTypeName (record.type) << " ";
+      if (record.index == DcfManager::TRACE_ALL_STATES)
+        {
+          std::cout << "all";
+        }
+      else
+        {
+          std::cout << record.index;
+        }
+      std::cout << " " << record.arg << "\n";
+    }
+
+  return 0;
+}
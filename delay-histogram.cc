@@ -0,0 +1,208 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/assert.h"
+#include "ns3/log.h"
+#include <algorithm>
+#include <cmath>
+#include "delay-histogram.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("DelayHistogram");
+
+NS_OBJECT_ENSURE_REGISTERED (DelayTag);
+
+TypeId
+DelayTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::DelayTag")
+    .SetParent<Tag> ()
+    .SetGroupName ("Stats")
+    .AddConstructor<DelayTag> ()
+  ;
+  return tid;
+}
+
+TypeId
+DelayTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+DelayTag::DelayTag ()
+  : m_sendTime (Seconds (0))
+{
+}
+
+DelayTag::DelayTag (Time sendTime)
+  : m_sendTime (sendTime)
+{
+}
+
+uint32_t
+DelayTag::GetSerializedSize (void) const
+{
+  return 8;
+}
+
+void
+DelayTag::Serialize (TagBuffer i) const
+{
+  i.WriteU64 (m_sendTime.GetTimeStep ());
+}
+
+void
+DelayTag::Deserialize (TagBuffer i)
+{
+  m_sendTime = TimeStep (i.ReadU64 ());
+}
+
+void
+DelayTag::Print (std::ostream &os) const
+{
+  os << "SendTime=" << m_sendTime;
+}
+
+Time
+DelayTag::GetSendTime (void) const
+{
+  return m_sendTime;
+}
+
+
+DelayHistogram::DelayHistogram ()
+  : m_n (0),
+    m_min (0),
+    m_max (0),
+    m_sum (0)
+{
+  std::fill (m_counts, m_counts + BUCKETS, 0);
+}
+
+uint32_t
+DelayHistogram::GetBucket (uint64_t ns)
+{
+  if (ns < SUB_BUCKETS)
+    {
+      return ns;
+    }
+  //position of the most significant bit, at least 4
+  uint32_t msb = 63;
+  while (!(ns >> msb))
+    {
+      msb--;
+    }
+  //the 4 bits below the most significant bit select the sub-bucket
+  return SUB_BUCKETS * (msb - 3) + ((ns >> (msb - 4)) & (SUB_BUCKETS - 1));
+}
+
+uint64_t
+DelayHistogram::GetBucketStart (uint32_t bucket)
+{
+  if (bucket < SUB_BUCKETS)
+    {
+      return bucket;
+    }
+  uint32_t msb = bucket / SUB_BUCKETS + 3;
+  return static_cast<uint64_t> (SUB_BUCKETS + bucket % SUB_BUCKETS) << (msb - 4);
+}
+
+void
+DelayHistogram::Add (Time delay)
+{
+  int64_t signedNs = delay.GetNanoSeconds ();
+  uint64_t ns = signedNs > 0 ? signedNs : 0;
+  m_counts[GetBucket (ns)]++;
+  if (m_n == 0 || ns < m_min)
+    {
+      m_min = ns;
+    }
+  if (m_n == 0 || ns > m_max)
+    {
+      m_max = ns;
+    }
+  m_n++;
+  m_sum += ns;
+}
+
+void
+DelayHistogram::Merge (const DelayHistogram &other)
+{
+  if (other.m_n == 0)
+    {
+      return;
+    }
+  for (uint32_t i = 0; i < BUCKETS; i++)
+    {
+      m_counts[i] += other.m_counts[i];
+    }
+  m_min = m_n == 0 ? other.m_min : std::min (m_min, other.m_min);
+  m_max = m_n == 0 ? other.m_max : std::max (m_max, other.m_max);
+  m_n += other.m_n;
+  m_sum += other.m_sum;
+}
+
+uint64_t
+DelayHistogram::GetN (void) const
+{
+  return m_n;
+}
+
+Time
+DelayHistogram::GetMin (void) const
+{
+  return NanoSeconds (m_min);
+}
+
+Time
+DelayHistogram::GetMax (void) const
+{
+  return NanoSeconds (m_max);
+}
+
+Time
+DelayHistogram::GetMean (void) const
+{
+  return NanoSeconds (m_n > 0 ? static_cast<int64_t> (m_sum / m_n) : 0);
+}
+
+Time
+DelayHistogram::GetQuantile (double q) const
+{
+  NS_ASSERT (q >= 0 && q <= 1);
+  if (m_n == 0)
+    {
+      return Seconds (0);
+    }
+  uint64_t rank = static_cast<uint64_t> (std::ceil (q * m_n));
+  rank = std::max<uint64_t> (rank, 1);
+  uint64_t count = 0;
+  uint32_t bucket = 0;
+  while (count + m_counts[bucket] < rank)
+    {
+      count += m_counts[bucket];
+      bucket++;
+    }
+  //the middle of the bucket, within the delays which were seen
+  uint64_t start = GetBucketStart (bucket);
+  uint64_t end = bucket + 1 < BUCKETS ? GetBucketStart (bucket + 1) : m_max + 1;
+  uint64_t ns = start + (end - start) / 2;
+  ns = std::min (std::max (ns, m_min), m_max);
+  return NanoSeconds (ns);
+}
+
+} //namespace ns3
@@ -0,0 +1,142 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DELAY_HISTOGRAM_H
+#define DELAY_HISTOGRAM_H
+
+#include "ns3/nstime.h"
+#include "ns3/tag.h"
+
+namespace ns3 {
+
+/**
+ * \brief Send time of a packet
+ * \ingroup stats
+ *
+ * Added to a packet by its sender, so that its receiver can compute its
+ * one-way delay.
+ */
+class DelayTag : public Tag
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  DelayTag ();
+  /**
+   * \param sendTime the time at which the packet is sent
+   */
+  DelayTag (Time sendTime);
+
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+  /**
+   * \return the time at which the packet was sent
+   */
+  Time GetSendTime (void) const;
+
+
+private:
+  Time m_sendTime; //!< time at which the packet was sent
+};
+
+/**
+ * \brief Fixed-memory histogram of delays
+ * \ingroup stats
+ *
+ * The delays, in nanoseconds, are counted in log-linear buckets: below
+ * 16 ns each value has its own bucket, and each power of two above is
+ * split into 16 buckets of the same width. A quantile is thus within
+ * 1/32 (about 3%) of the exact one, whatever the range of the delays,
+ * and the histogram takes the same few kilobytes whatever the number
+ * of delays. Histograms can be merged, e.g., to get the quantiles of
+ * all the flows from the histograms of each flow.
+ */
+class DelayHistogram
+{
+public:
+  DelayHistogram ();
+
+  /**
+   * \param delay a delay, negative delays being counted as 0
+   */
+  void Add (Time delay);
+  /**
+   * Add all the delays of another histogram.
+   *
+   * \param other the other histogram
+   */
+  void Merge (const DelayHistogram &other);
+
+  /**
+   * \return the number of delays
+   */
+  uint64_t GetN (void) const;
+  /**
+   * \return the smallest delay
+   */
+  Time GetMin (void) const;
+  /**
+   * \return the largest delay
+   */
+  Time GetMax (void) const;
+  /**
+   * \return the mean delay
+   */
+  Time GetMean (void) const;
+  /**
+   * \param q the quantile, between 0 and 1, e.g., 0.999 for the 99.9th
+   *        percentile
+   * \return the smallest delay such that a fraction q of the delays are
+   *         at most this delay, up to the width of its bucket
+   */
+  Time GetQuantile (double q) const;
+
+
+private:
+  /// Number of buckets per power of two
+  static const uint32_t SUB_BUCKETS = 16;
+  /// Number of buckets, enough for any 64 bit value
+  static const uint32_t BUCKETS = SUB_BUCKETS * (64 - 4 + 1);
+
+  /**
+   * \param ns a delay in nanoseconds
+   * \return the bucket of the delay
+   */
+  static uint32_t GetBucket (uint64_t ns);
+  /**
+   * \param bucket a bucket
+   * \return the smallest delay of the bucket, in nanoseconds
+   */
+  static uint64_t GetBucketStart (uint32_t bucket);
+
+  uint64_t m_counts[BUCKETS]; //!< number of delays in each bucket
+  uint64_t m_n;               //!< number of delays
+  uint64_t m_min;             //!< smallest delay, in nanoseconds
+  uint64_t m_max;             //!< largest delay, in nanoseconds
+  double m_sum;               //!< sum of the delays, in nanoseconds
+};
+
+} //namespace ns3
+
+#endif /* DELAY_HISTOGRAM_H */
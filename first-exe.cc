@@ -19,11 +19,41 @@
 #include "ns3/internet-module.h"
 #include "ns3/point-to-point-module.h"
 #include "ns3/applications-module.h"
+#include "ns3/delay-histogram.h"
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("FirstScriptExample");
 
+//one-way delays of the echo requests, from the DelayTag of each packet
+static DelayHistogram g_delays;
+
+static void
+TagSent (Ptr<const Packet> packet)
+{
+  packet->AddPacketTag (DelayTag (Simulator::Now ()));
+}
+
+static void
+RecordDelay (Ptr<const Packet> packet)
+{
+  //the echo server removes the tags after this trace
+  DelayTag tag;
+  if (packet->PeekPacketTag (tag))
+    {
+      g_delays.Add (Simulator::Now () - tag.GetSendTime ());
+    }
+}
+
+static void
+PrintDelays (void)
+{
+  std::cout << "one-way delays: " << g_delays.GetN () << "\n";
+  std::cout << "one-way delay p50: " << g_delays.GetQuantile (0.5).GetSeconds () * 1000 << " ms\n";
+  std::cout << "one-way delay p99: " << g_delays.GetQuantile (0.99).GetSeconds () * 1000 << " ms\n";
+  std::cout << "one-way delay p99.9: " << g_delays.GetQuantile (0.999).GetSeconds () * 1000 << " ms\n";
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -63,6 +93,7 @@ main (int argc, char *argv[])
   ApplicationContainer serverApps = echoServer.Install (nodes.Get (0));
   serverApps.Start (Seconds (1.0));
   serverApps.Stop (Seconds (25.0));
+  serverApps.Get (0)->TraceConnectWithoutContext ("Rx", MakeCallback (&RecordDelay));
 
   //Install p2p link between server and all clients
   //and assign IP to net device each time 
@@ -98,9 +129,11 @@ main (int argc, char *argv[])
   ApplicationContainer clientApps = echoClient.Install (nodes.Get (i+1));
   clientApps.Start (Seconds (2.0));
   clientApps.Stop (Seconds (25.0));
+  clientApps.Get (0)->TraceConnectWithoutContext ("Tx", MakeCallback (&TagSent));
 }
 
   Simulator::Run ();
   Simulator::Destroy ();
+  PrintDelays ();
   return 0;
 }
@@ -22,6 +22,9 @@
 #include "ns3/mobility-module.h"
 #include "ns3/csma-module.h"
 #include "ns3/internet-module.h"
+#include "ns3/async-pcap-writer.h"
+#include "ns3/wifi-pcap-sniffer.h"
+#include "ns3/delay-histogram.h"
 
 // Default Network Topology
 //
@@ -38,10 +41,56 @@
 //                                   ================
 //                                     LAN 10.1.2.0
 
+// With --asyncPcap=1 the pcap files are written by AsyncPcapWriter from a
+// background thread. The wifi frames are captured from the monitor
+// sniffer trace sources of the PHY in the data link type of the pcap
+// helper of the PHY (see WifiPcapSniffer), so that both ways give the
+// same files.
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("ThirdScriptExample");
 
+//capture the packets of a device from one of its trace sources
+static Ptr<AsyncPcapWriter>
+EnableAsyncPcap (std::string prefix, Ptr<Object> source, std::string trace,
+                 Ptr<NetDevice> device, uint32_t dataLinkType)
+{
+  Ptr<AsyncPcapWriter> writer = CreateObject<AsyncPcapWriter> ();
+  writer->Open (PcapHelper ().GetFilenameFromDevice (prefix, device), dataLinkType);
+  source->TraceConnectWithoutContext (trace, MakeCallback (&AsyncPcapWriter::Sniff, writer));
+  return writer;
+}
+
+//one-way delays of the echo requests, from the DelayTag of each packet
+static DelayHistogram g_delays;
+
+static void
+TagSent (Ptr<const Packet> packet)
+{
+  packet->AddPacketTag (DelayTag (Simulator::Now ()));
+}
+
+static void
+RecordDelay (Ptr<const Packet> packet)
+{
+  //the echo server removes the tags after this trace
+  DelayTag tag;
+  if (packet->PeekPacketTag (tag))
+    {
+      g_delays.Add (Simulator::Now () - tag.GetSendTime ());
+    }
+}
+
+static void
+PrintDelays (void)
+{
+  std::cout << "one-way delays: " << g_delays.GetN () << "\n";
+  std::cout << "one-way delay p50: " << g_delays.GetQuantile (0.5).GetSeconds () * 1000 << " ms\n";
+  std::cout << "one-way delay p99: " << g_delays.GetQuantile (0.99).GetSeconds () * 1000 << " ms\n";
+  std::cout << "one-way delay p99.9: " << g_delays.GetQuantile (0.999).GetSeconds () * 1000 << " ms\n";
+}
+
 int 
 main (int argc, char *argv[])
 {
@@ -49,12 +98,14 @@ main (int argc, char *argv[])
   uint32_t nCsma = 3;
   uint32_t nWifi = 4;
   bool tracing = true;
+  bool asyncPcap = false;
 
   CommandLine cmd;
   cmd.AddValue ("nCsma", "Number of \"extra\" CSMA nodes/devices", nCsma);
   cmd.AddValue ("nWifi", "Number of wifi STA devices", nWifi);
   cmd.AddValue ("verbose", "Tell echo applications to log if true", verbose);
   cmd.AddValue ("tracing", "Enable pcap tracing", tracing);
+  cmd.AddValue ("asyncPcap", "Write the pcap files from a background thread", asyncPcap);
 
   cmd.Parse (argc,argv);
 
@@ -161,6 +212,7 @@ main (int argc, char *argv[])
   ApplicationContainer serverApps = echoServer.Install (csmaNodes.Get (nCsma));
   serverApps.Start (Seconds (1.0));
   serverApps.Stop (Seconds (10.0));
+  serverApps.Get (0)->TraceConnectWithoutContext ("Rx", MakeCallback (&RecordDelay));
 
   UdpEchoClientHelper echoClient (csmaInterfaces.GetAddress (nCsma), 9);
   echoClient.SetAttribute ("MaxPackets", UintegerValue (4));
@@ -174,13 +226,31 @@ main (int argc, char *argv[])
   clientApps = echoClient.Install (wifiStaNodes.Get (i));
   clientApps.Start (Seconds (2.0));
   clientApps.Stop (Seconds (10.0));
+  clientApps.Get (0)->TraceConnectWithoutContext ("Tx", MakeCallback (&TagSent));
   }
 
   Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
 
   Simulator::Stop (Seconds (10.0));
 
-  if (tracing == true)
+  std::vector<Ptr<AsyncPcapWriter> > writers;
+  if (tracing == true && asyncPcap)
+    {
+      for (uint32_t i = 0; i < p2pDevices.GetN (); i++)
+        {
+          writers.push_back (EnableAsyncPcap ("third", p2pDevices.Get (i), "PromiscSniffer",
+                                              p2pDevices.Get (i), PcapHelper::DLT_PPP));
+        }
+      //phy keeps the default data link type of the pcap helper
+      Ptr<AsyncPcapWriter> apWriter = CreateObject<AsyncPcapWriter> ();
+      apWriter->Open (PcapHelper ().GetFilenameFromDevice ("third", apDevices.Get (0)), PcapHelper::DLT_IEEE802_11);
+      WifiPcapSniffer::Connect (DynamicCast<WifiNetDevice> (apDevices.Get (0))->GetPhy (), PcapHelper::DLT_IEEE802_11,
+                                MakeCallback (&AsyncPcapWriter::Write, apWriter));
+      writers.push_back (apWriter);
+      writers.push_back (EnableAsyncPcap ("third", csmaDevices.Get (0), "PromiscSniffer",
+                                          csmaDevices.Get (0), PcapHelper::DLT_EN10MB));
+    }
+  else if (tracing == true)
     {
       pointToPoint.EnablePcapAll ("third");
       phy.EnablePcap ("third", apDevices.Get (0));
@@ -188,6 +258,11 @@ main (int argc, char *argv[])
     }
 
   Simulator::Run ();
+  for (uint32_t i = 0; i < writers.size (); i++)
+    {
+      writers[i]->Close ();
+    }
   Simulator::Destroy ();
+  PrintDelays ();
   return 0;
 }
@@ -0,0 +1,651 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Parameter sweep of simple-ht-hidden-stations. Each point of the grid is
+// simulated by independent processes of the scenario program, and up to
+// --jobs of them run at the same time (one per core by default).
+//
+// Each parameter takes a comma-separated list of values, and every
+// combination is run:
+//
+//   ./waf --run "simple-ht-hidden-stations-sweep
+//       --program=build/src/dcf-experiments/ns3.26-simple-ht-hidden-stations-debug
+//       --nMpdus=1,8,32 --enableRts=0,1 --interval=0.0039,0.001"
+//
+// --args is appended to the command line of every run, e.g.
+// --args="--hiddenNodes=0 --nStations=8".
+//
+// With --maxReplications=N, each point is replicated until the confidence
+// interval of each of the --metrics is narrower than --relativeWidth times
+// its mean (or --absoluteWidth), after at least --minReplications and at
+// most N replications. The free jobs always go to the points with the
+// fewest replications, so the points which converge quickly stop early
+// and the noisy ones get the remaining CPU time. Replications still
+// running when their point stops are killed.
+//
+// Replication r of point p is given --RngRun=runBase+p*maxReplications+r,
+// and a point stops at the first n replications (in order) which meet the
+// target, so a sweep gives the same results whatever the number of jobs.
+//
+// The output of each replication goes to <output>-<p>-<r>.log. Every
+// "name: number" line of the output becomes a column of <output>.csv,
+// which has one row per replication, and <output>-summary.csv gives the
+// mean and confidence interval half-width of the --metrics for each
+// point. The scenario prints, e.g., "Throughput" and "client 0
+// throughput" metrics.
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SimpleHtHiddenStationsSweep");
+
+/**
+ * A swept parameter of simple-ht-hidden-stations
+ */
+struct SweepParameter
+{
+  std::string name;                //!< command line option of the scenario
+  std::vector<std::string> values; //!< values to sweep
+};
+
+/**
+ * A replication of a point of the grid
+ */
+struct SweepRun
+{
+  uint32_t point;                  //!< index of the point
+  uint32_t replication;            //!< index of the replication of the point
+  uint32_t rngRun;                 //!< value of the RngRun global value
+  pid_t pid;                       //!< process of the run, 0 once it ended
+  bool finished;                   //!< whether the process ended
+  bool cancelled;                  //!< whether the process was killed as not needed
+  int status;                      //!< exit status of the process
+  std::vector<std::pair<std::string, std::string> > metrics; //!< name and value of each metric
+};
+
+/**
+ * A point of the grid
+ */
+struct SweepPoint
+{
+  std::vector<std::string> values; //!< value of each SweepParameter
+  std::vector<int32_t> runs;       //!< index of the SweepRun of each replication, -1 if not started
+  uint32_t started;                //!< number of replications started
+  uint32_t used;                   //!< number of replications in the summary
+  bool done;                       //!< whether no more replication is needed
+  bool converged;                  //!< whether the confidence intervals met the target
+  bool failed;                     //!< whether a replication failed
+};
+
+static std::vector<std::string>
+Split (const std::string &list, char separator)
+{
+  std::vector<std::string> items;
+  std::istringstream is (list);
+  std::string item;
+  while (std::getline (is, item, separator))
+    {
+      if (!item.empty ())
+        {
+          items.push_back (item);
+        }
+    }
+  return items;
+}
+
+static std::string
+GetLogName (const std::string &output, uint32_t point, uint32_t replication)
+{
+  std::ostringstream os;
+  os << output << "-" << point << "-" << replication << ".log";
+  return os.str ();
+}
+
+static pid_t
+StartRun (const std::string &program, const std::vector<SweepParameter> &parameters,
+          const std::vector<std::string> &values, uint32_t rngRun,
+          const std::string &args, const std::string &log)
+{
+  std::vector<std::string> argv;
+  argv.push_back (program);
+  for (uint32_t i = 0; i < parameters.size (); i++)
+    {
+      argv.push_back ("--" + parameters[i].name + "=" + values[i]);
+    }
+  std::ostringstream os;
+  os << "--RngRun=" << rngRun;
+  argv.push_back (os.str ());
+  std::vector<std::string> extra = Split (args, ' ');
+  argv.insert (argv.end (), extra.begin (), extra.end ());
+
+  pid_t pid = fork ();
+  if (pid < 0)
+    {
+      NS_FATAL_ERROR ("cannot fork: " << std::strerror (errno));
+    }
+  if (pid == 0)
+    {
+      int fd = open (log.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0)
+        {
+          _exit (126);
+        }
+      dup2 (fd, STDOUT_FILENO);
+      dup2 (fd, STDERR_FILENO);
+      close (fd);
+      std::vector<char *> cargv;
+      for (uint32_t i = 0; i < argv.size (); i++)
+        {
+          cargv.push_back (const_cast<char *> (argv[i].c_str ()));
+        }
+      cargv.push_back (0);
+      execv (program.c_str (), &cargv[0]);
+      _exit (127);
+    }
+  return pid;
+}
+
+//collect the "name: number" lines of the output of a run
+static void
+ReadMetrics (const std::string &log, SweepRun &run)
+{
+  std::ifstream is (log.c_str ());
+  std::string line;
+  while (std::getline (is, line))
+    {
+      std::string::size_type colon = line.find (": ");
+      if (colon == std::string::npos || colon == 0)
+        {
+          continue;
+        }
+      std::string value = line.substr (colon + 2);
+      const char *start = value.c_str ();
+      char *end;
+      std::strtod (start, &end);
+      if (end == start)
+        {
+          continue;
+        }
+      std::string name = line.substr (0, colon);
+      std::replace (name.begin (), name.end (), ',', ';');
+      run.metrics.push_back (std::make_pair (name, value.substr (0, end - start)));
+    }
+}
+
+/**
+ * \param run a finished run
+ * \param name the name of a metric
+ * \param value the value of the metric
+ * \return true if the run printed the metric
+ */
+static bool
+GetMetric (const SweepRun &run, const std::string &name, double &value)
+{
+  bool found = false;
+  //the last value wins if a metric is printed several times
+  for (uint32_t i = 0; i < run.metrics.size (); i++)
+    {
+      if (run.metrics[i].first == name)
+        {
+          value = std::atof (run.metrics[i].second.c_str ());
+          found = true;
+        }
+    }
+  return found;
+}
+
+//p-quantile of the standard normal distribution
+static double
+GetNormalQuantile (double p)
+{
+  double low = -10;
+  double high = 10;
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      double x = (low + high) / 2;
+      if (0.5 * std::erfc (-x / std::sqrt (2.0)) < p)
+        {
+          low = x;
+        }
+      else
+        {
+          high = x;
+        }
+    }
+  return (low + high) / 2;
+}
+
+//p-quantile of the Student t distribution with dof degrees of freedom:
+//exact for 1 and 2 degrees of freedom, Cornish-Fisher expansion beyond,
+//which is within 1% from 3 degrees of freedom on
+static double
+GetStudentQuantile (double p, uint32_t dof)
+{
+  if (dof == 1)
+    {
+      return std::tan (M_PI * (p - 0.5));
+    }
+  if (dof == 2)
+    {
+      return (2 * p - 1) / std::sqrt (2 * p * (1 - p));
+    }
+  double z = GetNormalQuantile (p);
+  double z2 = z * z;
+  double n = dof;
+  return z
+    + z * (z2 + 1) / (4 * n)
+    + z * ((5 * z2 + 16) * z2 + 3) / (96 * n * n)
+    + z * (((3 * z2 + 19) * z2 + 17) * z2 - 15) / (384 * n * n * n);
+}
+
+/**
+ * \param samples at least two samples
+ * \param confidence the confidence level, e.g., 0.95
+ * \param mean the mean of the samples
+ * \return the half-width of the confidence interval of the mean
+ */
+static double
+GetConfidenceInterval (const std::vector<double> &samples, double confidence, double &mean)
+{
+  double n = samples.size ();
+  double sum = 0;
+  for (uint32_t i = 0; i < samples.size (); i++)
+    {
+      sum += samples[i];
+    }
+  mean = sum / n;
+  if (samples.size () < 2)
+    {
+      return 0;
+    }
+  double squares = 0;
+  for (uint32_t i = 0; i < samples.size (); i++)
+    {
+      squares += (samples[i] - mean) * (samples[i] - mean);
+    }
+  double stddev = std::sqrt (squares / (n - 1));
+  return GetStudentQuantile (1 - (1 - confidence) / 2, samples.size () - 1) * stddev / std::sqrt (n);
+}
+
+/**
+ * Decide whether a point needs more replications, from its replications
+ * which finished in order.
+ */
+static void
+UpdatePoint (SweepPoint &point, const std::vector<SweepRun> &runs,
+             const std::vector<std::string> &metrics, uint32_t minReplications,
+             uint32_t maxReplications, double confidence,
+             double relativeWidth, double absoluteWidth)
+{
+  std::vector<std::vector<double> > samples (metrics.size ());
+  for (uint32_t n = 1; n <= maxReplications && !point.done; n++)
+    {
+      int32_t index = point.runs[n - 1];
+      if (index < 0 || !runs[index].finished)
+        {
+          return;
+        }
+      const SweepRun &run = runs[index];
+      for (uint32_t i = 0; i < metrics.size (); i++)
+        {
+          double value;
+          if (run.status != 0 || !GetMetric (run, metrics[i], value))
+            {
+              point.failed = true;
+              point.done = true;
+              point.used = n - 1;
+              return;
+            }
+          samples[i].push_back (value);
+        }
+      if (n < minReplications || n < 2)
+        {
+          point.done = (n == maxReplications);
+          point.used = n;
+          continue;
+        }
+      bool converged = true;
+      for (uint32_t i = 0; i < metrics.size () && converged; i++)
+        {
+          double mean;
+          double halfWidth = GetConfidenceInterval (samples[i], confidence, mean);
+          converged = halfWidth <= std::max (relativeWidth * std::fabs (mean), absoluteWidth);
+        }
+      point.converged = converged;
+      point.done = converged || n == maxReplications;
+      point.used = n;
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string program = "build/src/dcf-experiments/ns3.26-simple-ht-hidden-stations-debug";
+  std::string nMpdus = "1";
+  std::string enableRts = "1";
+  std::string payloadSize = "1472";
+  std::string simulationTime = "10";
+  std::string interval = "0.0039";
+  std::string args = "";
+  std::string output = "sweep";
+  uint32_t jobs = 0;
+  uint32_t runBase = 1;
+  uint32_t minReplications = 3;
+  uint32_t maxReplications = 1;
+  std::string metricList = "Throughput,packet loss rate";
+  double confidence = 0.95;
+  double relativeWidth = 0.05;
+  double absoluteWidth = 0;
+
+  CommandLine cmd;
+  cmd.AddValue ("program", "Path of the simple-ht-hidden-stations executable", program);
+  cmd.AddValue ("nMpdus", "Comma-separated numbers of aggregated MPDUs", nMpdus);
+  cmd.AddValue ("enableRts", "Comma-separated RTS/CTS settings (0 or 1)", enableRts);
+  cmd.AddValue ("payloadSize", "Comma-separated payload sizes in bytes", payloadSize);
+  cmd.AddValue ("simulationTime", "Comma-separated simulation times in seconds", simulationTime);
+  cmd.AddValue ("interval", "Comma-separated packet intervals in seconds", interval);
+  cmd.AddValue ("args", "Space-separated options added to every run", args);
+  cmd.AddValue ("output", "Prefix of the CSV files and of the logs of the runs", output);
+  cmd.AddValue ("jobs", "Number of runs at the same time, 0 for one per core", jobs);
+  cmd.AddValue ("runBase", "RngRun of the first run of the grid", runBase);
+  cmd.AddValue ("minReplications", "Minimum number of replications of each point", minReplications);
+  cmd.AddValue ("maxReplications", "Maximum number of replications of each point", maxReplications);
+  cmd.AddValue ("metrics", "Comma-separated metrics whose confidence intervals decide when to stop", metricList);
+  cmd.AddValue ("confidence", "Confidence level of the intervals", confidence);
+  cmd.AddValue ("relativeWidth", "Target half-width of the intervals, relative to the mean", relativeWidth);
+  cmd.AddValue ("absoluteWidth", "Target half-width of the intervals, in the unit of the metric", absoluteWidth);
+  cmd.Parse (argc, argv);
+
+  if (jobs == 0)
+    {
+      long cores = sysconf (_SC_NPROCESSORS_ONLN);
+      jobs = cores > 0 ? cores : 1;
+    }
+  if (maxReplications == 0)
+    {
+      NS_FATAL_ERROR ("maxReplications must be at least 1");
+    }
+  minReplications = std::min (std::max (minReplications, 1u), maxReplications);
+  std::vector<std::string> metrics = Split (metricList, ',');
+
+  std::vector<SweepParameter> parameters;
+  const char *names[] = {"nMpdus", "enableRts", "payloadSize", "simulationTime", "interval"};
+  const std::string *lists[] = {&nMpdus, &enableRts, &payloadSize, &simulationTime, &interval};
+  for (uint32_t i = 0; i < 5; i++)
+    {
+      SweepParameter parameter;
+      parameter.name = names[i];
+      parameter.values = Split (*lists[i], ',');
+      if (parameter.values.empty ())
+        {
+          NS_FATAL_ERROR ("no value for " << parameter.name);
+        }
+      parameters.push_back (parameter);
+    }
+
+  //expand the grid, the last parameter varying the fastest
+  std::vector<SweepPoint> points;
+  std::vector<uint32_t> position (parameters.size (), 0);
+  bool done = false;
+  while (!done)
+    {
+      SweepPoint point;
+      for (uint32_t i = 0; i < parameters.size (); i++)
+        {
+          point.values.push_back (parameters[i].values[position[i]]);
+        }
+      point.runs.assign (maxReplications, -1);
+      point.started = 0;
+      point.used = 0;
+      point.done = false;
+      point.converged = false;
+      point.failed = false;
+      points.push_back (point);
+      done = true;
+      for (uint32_t i = parameters.size (); i-- > 0; )
+        {
+          if (++position[i] < parameters[i].values.size ())
+            {
+              done = false;
+              break;
+            }
+          position[i] = 0;
+        }
+    }
+  std::cout << points.size () << " points, " << minReplications << " to "
+            << maxReplications << " replications each, " << jobs << " jobs" << std::endl;
+
+  SystemWallClockMs clock;
+  clock.Start ();
+  std::vector<SweepRun> runs;
+  uint32_t running = 0;
+  uint32_t nDone = 0;
+  while (nDone < points.size () || running > 0)
+    {
+      while (running < jobs)
+        {
+          //the free job goes to the point with the fewest replications
+          int32_t next = -1;
+          for (uint32_t i = 0; i < points.size (); i++)
+            {
+              if (!points[i].done && points[i].started < maxReplications
+                  && (next < 0 || points[i].started < points[next].started))
+                {
+                  next = i;
+                }
+            }
+          if (next < 0)
+            {
+              break;
+            }
+          SweepPoint &point = points[next];
+          SweepRun run;
+          run.point = next;
+          run.replication = point.started;
+          run.rngRun = runBase + next * maxReplications + run.replication;
+          run.finished = false;
+          run.cancelled = false;
+          run.status = 0;
+          run.pid = StartRun (program, parameters, point.values, run.rngRun, args,
+                              GetLogName (output, run.point, run.replication));
+          point.runs[run.replication] = runs.size ();
+          point.started++;
+          runs.push_back (run);
+          running++;
+        }
+      int status;
+      pid_t pid = waitpid (-1, &status, 0);
+      if (pid < 0)
+        {
+          NS_FATAL_ERROR ("waitpid failed: " << std::strerror (errno));
+        }
+      for (uint32_t i = 0; i < runs.size (); i++)
+        {
+          SweepRun &run = runs[i];
+          if (run.pid != pid)
+            {
+              continue;
+            }
+          run.pid = 0;
+          run.finished = true;
+          running--;
+          if (run.cancelled)
+            {
+              break;
+            }
+          run.status = WIFEXITED (status) ? WEXITSTATUS (status) : 128 + WTERMSIG (status);
+          ReadMetrics (GetLogName (output, run.point, run.replication), run);
+          SweepPoint &point = points[run.point];
+          UpdatePoint (point, runs, metrics, minReplications, maxReplications,
+                       confidence, relativeWidth, absoluteWidth);
+          std::cout << "point " << run.point << " replication " << run.replication << " done";
+          if (run.status != 0)
+            {
+              std::cout << ", exit status " << run.status;
+            }
+          std::cout << std::endl;
+          if (point.done)
+            {
+              nDone++;
+              //kill the replications which are no longer needed
+              for (uint32_t r = 0; r < point.started; r++)
+                {
+                  SweepRun &other = runs[point.runs[r]];
+                  if (!other.finished)
+                    {
+                      other.cancelled = true;
+                      kill (other.pid, SIGTERM);
+                    }
+                }
+              std::cout << "point " << run.point << " done after " << point.used << " replications"
+                        << (point.failed ? " (failed)" : point.converged ? " (converged)" : "") << std::endl;
+            }
+          break;
+        }
+    }
+  std::cout << "sweep done in " << clock.End () / 1000.0 << " s" << std::endl;
+
+  //the metric columns, in their order of appearance
+  std::vector<std::string> columns;
+  for (std::vector<SweepRun>::const_iterator i = runs.begin (); i != runs.end (); i++)
+    {
+      for (uint32_t j = 0; j < i->metrics.size (); j++)
+        {
+          if (std::find (columns.begin (), columns.end (), i->metrics[j].first) == columns.end ())
+            {
+              columns.push_back (i->metrics[j].first);
+            }
+        }
+    }
+
+  std::string csvName = output + ".csv";
+  std::ofstream csv (csvName.c_str ());
+  csv << "point,replication,RngRun,status,used";
+  for (uint32_t i = 0; i < parameters.size (); i++)
+    {
+      csv << "," << parameters[i].name;
+    }
+  for (uint32_t i = 0; i < columns.size (); i++)
+    {
+      csv << "," << columns[i];
+    }
+  csv << "\n";
+  for (uint32_t p = 0; p < points.size (); p++)
+    {
+      const SweepPoint &point = points[p];
+      for (uint32_t r = 0; r < point.started; r++)
+        {
+          const SweepRun &run = runs[point.runs[r]];
+          csv << p << "," << r << "," << run.rngRun << ",";
+          if (run.cancelled)
+            {
+              csv << "cancelled";
+            }
+          else
+            {
+              csv << run.status;
+            }
+          csv << "," << (r < point.used ? 1 : 0);
+          for (uint32_t j = 0; j < point.values.size (); j++)
+            {
+              csv << "," << point.values[j];
+            }
+          for (uint32_t j = 0; j < columns.size (); j++)
+            {
+              //the last value wins if a metric is printed several times
+              std::string value = "";
+              for (uint32_t k = 0; k < run.metrics.size (); k++)
+                {
+                  if (run.metrics[k].first == columns[j])
+                    {
+                      value = run.metrics[k].second;
+                    }
+                }
+              csv << "," << value;
+            }
+          csv << "\n";
+        }
+    }
+  std::cout << "results written to " << csvName << std::endl;
+
+  std::string summaryName = output + "-summary.csv";
+  std::ofstream summary (summaryName.c_str ());
+  summary << "point";
+  for (uint32_t i = 0; i < parameters.size (); i++)
+    {
+      summary << "," << parameters[i].name;
+    }
+  summary << ",replications,converged,failed";
+  for (uint32_t i = 0; i < metrics.size (); i++)
+    {
+      summary << "," << metrics[i] << " mean," << metrics[i] << " ci";
+    }
+  summary << "\n";
+  for (uint32_t p = 0; p < points.size (); p++)
+    {
+      const SweepPoint &point = points[p];
+      summary << p;
+      std::cout << "point " << p << ":";
+      for (uint32_t j = 0; j < point.values.size (); j++)
+        {
+          summary << "," << point.values[j];
+          std::cout << " " << parameters[j].name << "=" << point.values[j];
+        }
+      summary << "," << point.used << "," << point.converged << "," << point.failed;
+      std::cout << " (" << point.used << " replications)" << std::endl;
+      for (uint32_t i = 0; i < metrics.size (); i++)
+        {
+          std::vector<double> samples;
+          for (uint32_t r = 0; r < point.used; r++)
+            {
+              double value;
+              if (GetMetric (runs[point.runs[r]], metrics[i], value))
+                {
+                  samples.push_back (value);
+                }
+            }
+          if (samples.empty ())
+            {
+              summary << ",,";
+              continue;
+            }
+          double mean;
+          double halfWidth = GetConfidenceInterval (samples, confidence, mean);
+          summary << "," << mean << "," << halfWidth;
+          std::cout << "  " << metrics[i] << ": " << mean << " +/- " << halfWidth << std::endl;
+        }
+      summary << "\n";
+    }
+  std::cout << "summary written to " << summaryName << std::endl;
+
+  return 0;
+}
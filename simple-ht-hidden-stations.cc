@@ -6,20 +6,42 @@
 #include "ns3/mobility-module.h"
 #include "ns3/ipv4-global-routing-helper.h"
 #include "ns3/internet-module.h"
+#include "ns3/dcf-manager.h"
+#include "ns3/dcf-analytical-model.h"
+#include "ns3/delay-histogram.h"
+#include "ns3/async-pcap-writer.h"
+#include "ns3/wifi-pcap-sniffer.h"
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
 #include <string>
+#include <vector>
 // This example considers two hidden stations in an 802.11n network which supports MPDU aggregation.
 // The user can specify whether RTS/CTS is used and can set the number of aggregated MPDUs.
 //
 // Example: ./waf --run "simple-ht-hidden-stations --enableRts=1 --nMpdus=8"
 //
+// --nStations stations are placed on a circle of radius 5 meters around
+// the AP, each with a UDP echo client towards its own echo server on the
+// AP. The packets, throughput and delay percentiles of each client are
+// reported, also as "name: number" lines for
+// simple-ht-hidden-stations-sweep. With more than 6 stations, neighbours
+// are no longer hidden from each other. The other options (analytical
+// model, steady state detection, time series, captures and DcfManager
+// statistics) are described by --PrintHelp.
+//
 // Network topology:
 //
 //   Wifi 192.168.1.0
 //
-//        AP
-//   *    *    *
-//   |    |    |
-//   n1   n2   n3
+//             n1
+//             |
+//        n2   AP   n4
+//             |
+//             n3
 //
 // Packets in this simulation aren't marked with a QosTag so they are considered
 // belonging to BestEffort Access Class (AC_BE).
@@ -28,52 +50,981 @@ using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("SimplesHtHiddenStations");
 
-//declare variables needed 
-int packetSent = 0;
-int packetRec = 0;
+/**
+ * Per-client packet counters and delays. Each client and its echo server
+ * get their own counter slot when they are added, and the trace sinks are
+ * bound to that slot, so counting a packet does not depend on the trace
+ * context or on the number of clients.
+ *
+ * The packets sent by the clients are tagged with a DelayTag, which gives
+ * their one-way delay when the server receives them. The echo server
+ * removes the tags before echoing a packet, so the round-trip delay is
+ * found from the uid of the echoed packet instead, among the last
+ * ECHO_WINDOW packets sent by the client, which are kept in a ring indexed
+ * by their sequence number. A packet whose slot is reused before its echo
+ * came is counted as unmatched, and reported with the percentiles since
+ * its round-trip delay is missing from them.
+ */
+class ClientStatistics
+{
+public:
+  /**
+   * \param client the UdpEchoClient of the client
+   * \param server the UdpEchoServer which the client sends to
+   * \param port the port of the server
+   * \return the index of the client
+   */
+  uint32_t Add (Ptr<Application> client, Ptr<Application> server, uint16_t port);
+
+  /**
+   * \return the number of clients
+   */
+  uint32_t GetN (void) const;
+  /**
+   * \return the number of packets sent by all the clients
+   */
+  uint64_t GetSent (void) const;
+  /**
+   * \return the number of packets received from all the clients
+   */
+  uint64_t GetReceived (void) const;
+  /**
+   * \param client the index of the client
+   * \return the number of packets sent by the client
+   */
+  uint64_t GetSent (uint32_t client) const;
+  /**
+   * \param client the index of the client
+   * \return the number of packets received from the client
+   */
+  uint64_t GetReceived (uint32_t client) const;
+
+  /**
+   * Print the packets sent, received and lost and the throughput of
+   * each client.
+   *
+   * \param os the output stream
+   * \param payloadSize the size of the packets, in bytes
+   * \param duration the duration over which the throughput is computed
+   */
+  void Print (std::ostream &os, uint32_t payloadSize, Time duration) const;
+  /**
+   * Print the same counters as Print as "client <n> <name>: <value>"
+   * lines, which simple-ht-hidden-stations-sweep collects into its CSV.
+   *
+   * \param os the output stream
+   * \param payloadSize the size of the packets, in bytes
+   * \param duration the duration over which the throughput is computed
+   */
+  void PrintMetrics (std::ostream &os, uint32_t payloadSize, Time duration) const;
+  /**
+   * Print the median, 99th and 99.9th percentiles of the one-way and
+   * round-trip delays of each client.
+   *
+   * \param os the output stream
+   */
+  void PrintDelays (std::ostream &os) const;
+
+  /**
+   * \return the number of packets sent by all the clients whose echo was
+   *         not received before ECHO_WINDOW more packets were sent
+   */
+  uint64_t GetUnmatched (void) const;
+
+  /**
+   * \return the one-way delays of all the clients
+   */
+  DelayHistogram GetOneWayDelays (void) const;
+  /**
+   * \return the round-trip delays of all the clients
+   */
+  DelayHistogram GetRoundTripDelays (void) const;
+
+
+private:
+  /// Number of packets sent by a client whose echo is waited for
+  static const uint32_t ECHO_WINDOW = 1024;
+
+  /// A packet sent by a client
+  struct Outstanding
+  {
+    uint64_t uid;                  //!< uid of the packet
+    Time sendTime;                 //!< time at which it was sent
+    bool waiting;                  //!< whether its echo is still waited for
+  };
+
+  /// Counters of a client
+  struct Counters
+  {
+    uint16_t port;                 //!< port of the server
+    uint64_t sent;                 //!< packets sent by the client
+    uint64_t received;             //!< packets received by its server
+    DelayHistogram oneWay;         //!< delays from the client to the server
+    DelayHistogram roundTrip;      //!< delays from the client back to the client
+    uint64_t unmatched;            //!< packets whose slot was reused before their echo came
+    uint64_t nextEcho;             //!< sequence number following the last packet echoed
+    std::vector<Outstanding> outstanding; //!< last packets sent, by sequence number modulo ECHO_WINDOW
+  };
+
+  /**
+   * \param counters the counters of the client
+   * \param packet the packet sent by the client
+   */
+  static void Sent (Counters *counters, Ptr<const Packet> packet);
+  /**
+   * \param counters the counters of the client
+   * \param packet the packet received by the server
+   */
+  static void Received (Counters *counters, Ptr<const Packet> packet);
+  /**
+   * \param counters the counters of the client
+   * \param header the IP header of the packet
+   * \param packet a packet delivered to the node of the client
+   * \param interface the interface of the node
+   */
+  static void Echoed (Counters *counters, const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface);
+
+  std::deque<Counters> m_counters; //!< does not move the counters when growing
+};
+
+uint32_t
+ClientStatistics::Add (Ptr<Application> client, Ptr<Application> server, uint16_t port)
+{
+  m_counters.push_back (Counters ());
+  Counters &slot = m_counters.back ();
+  slot.port = port;
+  slot.sent = 0;
+  slot.received = 0;
+  slot.unmatched = 0;
+  slot.nextEcho = 0;
+  slot.outstanding.resize (ECHO_WINDOW, Outstanding ());
+  client->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&ClientStatistics::Sent, &slot));
+  server->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&ClientStatistics::Received, &slot));
+  client->GetNode ()->GetObject<Ipv4L3Protocol> ()
+    ->TraceConnectWithoutContext ("LocalDeliver", MakeBoundCallback (&ClientStatistics::Echoed, &slot));
+  return m_counters.size () - 1;
+}
+
+uint32_t
+ClientStatistics::GetN (void) const
+{
+  return m_counters.size ();
+}
+
+uint64_t
+ClientStatistics::GetSent (void) const
+{
+  uint64_t sent = 0;
+  for (std::deque<Counters>::const_iterator i = m_counters.begin (); i != m_counters.end (); i++)
+    {
+      sent += i->sent;
+    }
+  return sent;
+}
+
+uint64_t
+ClientStatistics::GetReceived (void) const
+{
+  uint64_t received = 0;
+  for (std::deque<Counters>::const_iterator i = m_counters.begin (); i != m_counters.end (); i++)
+    {
+      received += i->received;
+    }
+  return received;
+}
+
+uint64_t
+ClientStatistics::GetSent (uint32_t client) const
+{
+  return m_counters[client].sent;
+}
+
+uint64_t
+ClientStatistics::GetReceived (uint32_t client) const
+{
+  return m_counters[client].received;
+}
+
+void
+ClientStatistics::Print (std::ostream &os, uint32_t payloadSize, Time duration) const
+{
+  os << std::setw (8) << "client"
+     << std::setw (10) << "sent"
+     << std::setw (10) << "received"
+     << std::setw (10) << "lost"
+     << std::setw (10) << "loss (%)"
+     << std::setw (18) << "throughput (Mbps)" << "\n";
+  for (uint32_t i = 0; i < m_counters.size (); i++)
+    {
+      const Counters &counters = m_counters[i];
+      //echo replies lost on the way back do not count, as before
+      int64_t lost = static_cast<int64_t> (counters.sent) - static_cast<int64_t> (counters.received);
+      double loss = counters.sent > 0 ? 100.0 * lost / counters.sent : 0;
+      double throughput = counters.received * payloadSize * 8 / (duration.GetSeconds () * 1000000.0);
+      os << std::setw (8) << i
+         << std::setw (10) << counters.sent
+         << std::setw (10) << counters.received
+         << std::setw (10) << lost
+         << std::setw (10) << loss
+         << std::setw (18) << throughput << "\n";
+    }
+  os << "\n";
+}
+
+void
+ClientStatistics::PrintMetrics (std::ostream &os, uint32_t payloadSize, Time duration) const
+{
+  for (uint32_t i = 0; i < m_counters.size (); i++)
+    {
+      const Counters &counters = m_counters[i];
+      int64_t lost = static_cast<int64_t> (counters.sent) - static_cast<int64_t> (counters.received);
+      double loss = counters.sent > 0 ? 100.0 * lost / counters.sent : 0;
+      double throughput = counters.received * payloadSize * 8 / (duration.GetSeconds () * 1000000.0);
+      os << "client " << i << " sent: " << counters.sent << "\n";
+      os << "client " << i << " received: " << counters.received << "\n";
+      os << "client " << i << " lost: " << lost << "\n";
+      os << "client " << i << " packet loss rate: " << loss << "%\n";
+      os << "client " << i << " throughput: " << throughput << " Mbit/s\n";
+    }
+}
 
-int packetSent0 = 0;
-int packetRec0 = 0;
+void
+ClientStatistics::PrintDelays (std::ostream &os) const
+{
+  os << std::setw (8) << "client"
+     << std::setw (14) << "one-way p50"
+     << std::setw (14) << "one-way p99"
+     << std::setw (14) << "one-way p99.9"
+     << std::setw (14) << "rtt p50"
+     << std::setw (14) << "rtt p99"
+     << std::setw (14) << "rtt p99.9"
+     << std::setw (12) << "unmatched" << "  (ms)\n";
+  for (uint32_t i = 0; i < m_counters.size (); i++)
+    {
+      const Counters &counters = m_counters[i];
+      os << std::setw (8) << i
+         << std::setw (14) << counters.oneWay.GetQuantile (0.5).GetSeconds () * 1000
+         << std::setw (14) << counters.oneWay.GetQuantile (0.99).GetSeconds () * 1000
+         << std::setw (14) << counters.oneWay.GetQuantile (0.999).GetSeconds () * 1000
+         << std::setw (14) << counters.roundTrip.GetQuantile (0.5).GetSeconds () * 1000
+         << std::setw (14) << counters.roundTrip.GetQuantile (0.99).GetSeconds () * 1000
+         << std::setw (14) << counters.roundTrip.GetQuantile (0.999).GetSeconds () * 1000
+         << std::setw (12) << counters.unmatched << "\n";
+    }
+  os << "\n";
+}
 
-int packetSent1 = 0;
-int packetRec1 = 0;
+uint64_t
+ClientStatistics::GetUnmatched (void) const
+{
+  uint64_t unmatched = 0;
+  for (std::deque<Counters>::const_iterator i = m_counters.begin (); i != m_counters.end (); i++)
+    {
+      unmatched += i->unmatched;
+    }
+  return unmatched;
+}
 
-int packetSent2 = 0;
-int packetRec2 = 0;
+DelayHistogram
+ClientStatistics::GetOneWayDelays (void) const
+{
+  DelayHistogram delays;
+  for (std::deque<Counters>::const_iterator i = m_counters.begin (); i != m_counters.end (); i++)
+    {
+      delays.Merge (i->oneWay);
+    }
+  return delays;
+}
 
-int packetSent3 = 0;
-int packetRec3 = 0;
+DelayHistogram
+ClientStatistics::GetRoundTripDelays (void) const
+{
+  DelayHistogram delays;
+  for (std::deque<Counters>::const_iterator i = m_counters.begin (); i != m_counters.end (); i++)
+    {
+      delays.Merge (i->roundTrip);
+    }
+  return delays;
+}
+
+void
+ClientStatistics::Sent (Counters *counters, Ptr<const Packet> packet)
+{
+  packet->AddPacketTag (DelayTag (Simulator::Now ()));
+  Outstanding &slot = counters->outstanding[counters->sent % ECHO_WINDOW];
+  if (slot.waiting)
+    {
+      counters->unmatched++;
+    }
+  slot.uid = packet->GetUid ();
+  slot.sendTime = Simulator::Now ();
+  slot.waiting = true;
+  counters->sent++;
+}
 
-int lostPackets0 = 0, lostPackets1 = 0, lostPackets2 = 0, lostPackets3 = 0; 
-double throughput0 = 0, throughput1 = 0, throughput2 = 0, throughput3 = 0; 
-//trace sink function for keeping track of packets sent  
-void Send (std::string context, Ptr<const Packet> packet)
+void
+ClientStatistics::Received (Counters *counters, Ptr<const Packet> packet)
 {
-	NS_LOG_UNCOND(context);
-	packetSent+=1;  //total packets sent 
-        if(context == "/NodeList/0/ApplicationList/0/$ns3::UdpEchoClient/Tx") packetSent0++;
-	else if(context == "/NodeList/1/ApplicationList/0/$ns3::UdpEchoClient/Tx") packetSent1++;
-	else if(context == "/NodeList/2/ApplicationList/0/$ns3::UdpEchoClient/Tx") packetSent2++;
-	else if(context == "/NodeList/3/ApplicationList/0/$ns3::UdpEchoClient/Tx") packetSent3++;                      
+  counters->received++;
+  DelayTag tag;
+  if (packet->PeekPacketTag (tag))
+    {
+      counters->oneWay.Add (Simulator::Now () - tag.GetSendTime ());
+    }
 }
 
+void
+ClientStatistics::Echoed (Counters *counters, const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+{
+  UdpHeader udp;
+  if (header.GetProtocol () != UdpL4Protocol::PROT_NUMBER)
+    {
+      return;
+    }
+  packet->PeekHeader (udp);
+  if (udp.GetSourcePort () != counters->port)
+    {
+      return;
+    }
+  //the echoes mostly come back in order, so the search starts after the
+  //last packet echoed; an echo which is not found was counted as
+  //unmatched when its slot was reused
+  uint64_t first = counters->sent > ECHO_WINDOW ? counters->sent - ECHO_WINDOW : 0;
+  uint64_t n = counters->sent - first;
+  uint64_t start = counters->nextEcho > first ? counters->nextEcho - first : 0;
+  for (uint64_t i = 0; i < n; i++)
+    {
+      uint64_t sequence = first + (start + i) % n;
+      Outstanding &slot = counters->outstanding[sequence % ECHO_WINDOW];
+      if (slot.waiting && slot.uid == packet->GetUid ())
+        {
+          counters->roundTrip.Add (Simulator::Now () - slot.sendTime);
+          slot.waiting = false;
+          counters->nextEcho = sequence + 1;
+          return;
+        }
+    }
+}
+
+/**
+ * Time series of the offered load, throughput and loss rate of each
+ * client, written as CSV rows at the end of each window while the
+ * simulation runs. Only the counters at the start of the current window
+ * are kept, so the memory does not grow with the duration of the run.
+ */
+class ClientSeries
+{
+public:
+  /**
+   * \param statistics the counters of the clients
+   * \param payloadSize the size of the packets, in bytes
+   * \param window the duration of a window
+   */
+  ClientSeries (const ClientStatistics &statistics, uint32_t payloadSize, Time window);
+
+  /**
+   * Start writing windows.
+   *
+   * \param start the start of the first window
+   * \param filename the name of the CSV file
+   */
+  void Start (Time start, std::string filename);
+
+
+private:
+  /// Write a row per client for the window which ends now
+  void Sample (void);
+
+  const ClientStatistics &m_statistics; //!< counters of the clients
+  uint32_t m_payloadSize;               //!< size of the packets
+  Time m_window;                        //!< duration of a window
+  std::ofstream m_os;                   //!< the CSV file
+  std::vector<uint64_t> m_lastSent;     //!< packets sent by each client at the start of the window
+  std::vector<uint64_t> m_lastReceived; //!< packets received from each client at the start of the window
+};
+
+ClientSeries::ClientSeries (const ClientStatistics &statistics, uint32_t payloadSize, Time window)
+  : m_statistics (statistics),
+    m_payloadSize (payloadSize),
+    m_window (window)
+{
+}
+
+void
+ClientSeries::Start (Time start, std::string filename)
+{
+  m_os.open (filename.c_str ());
+  if (!m_os.is_open ())
+    {
+      NS_FATAL_ERROR ("cannot open " << filename);
+    }
+  m_os << "time,client,sent,received,offered (Mbps),throughput (Mbps),loss (%)\n";
+  m_lastSent.assign (m_statistics.GetN (), 0);
+  m_lastReceived.assign (m_statistics.GetN (), 0);
+  Simulator::Schedule (start + m_window - Simulator::Now (), &ClientSeries::Sample, this);
+}
+
+void
+ClientSeries::Sample (void)
+{
+  double bits = m_payloadSize * 8 / (m_window.GetSeconds () * 1000000.0);
+  for (uint32_t i = 0; i < m_lastSent.size (); i++)
+    {
+      uint64_t sent = m_statistics.GetSent (i) - m_lastSent[i];
+      uint64_t received = m_statistics.GetReceived (i) - m_lastReceived[i];
+      m_lastSent[i] += sent;
+      m_lastReceived[i] += received;
+      double loss = sent > 0 ? 100.0 * (static_cast<double> (sent) - received) / sent : 0;
+      m_os << Simulator::Now ().GetSeconds () << "," << i << "," << sent << "," << received
+           << "," << sent * bits << "," << received * bits << "," << loss << "\n";
+    }
+  //make the window available to the readers of the file during the run
+  m_os.flush ();
+  Simulator::Schedule (m_window, &ClientSeries::Sample, this);
+}
+
+/**
+ * Steady-state detector over the throughput of the clients, measured in
+ * fixed windows of simulated time.
+ *
+ * After each window, the warm-up transient (association, ARP) is located
+ * with MSER-5: the windows are grouped by 5 and the number of leading
+ * groups to drop is the one which minimizes the standard error of the mean
+ * of the remaining groups, searched in the first half of the run. The
+ * remaining windows are split into BATCHES batches, whose throughputs and
+ * loss rates give the batch means estimates and their 95% confidence
+ * intervals. Once both intervals are narrow enough, the simulation is
+ * stopped.
+ */
+class SteadyStateDetector
+{
+public:
+  /**
+   * \param statistics the counters of the clients
+   * \param payloadSize the size of the packets, in bytes
+   * \param window the duration of a window
+   * \param precision the target half-width of the throughput confidence
+   *        interval, relative to the throughput
+   * \param lossPrecision the target half-width of the loss rate confidence
+   *        interval, in percent
+   */
+  SteadyStateDetector (const ClientStatistics &statistics, uint32_t payloadSize,
+                       Time window, double precision, double lossPrecision);
+
+  /**
+   * Start measuring windows.
+   *
+   * \param start the start of the first window
+   */
+  void Start (Time start);
+
+  /**
+   * \return true if the estimates converged
+   */
+  bool IsSteady (void) const;
+  /**
+   * \return the start of the steady state
+   */
+  Time GetSteadyStart (void) const;
+  /**
+   * \return the number of windows measured
+   */
+  uint32_t GetN (void) const;
+  /**
+   * \return the number of windows of the transient, which are dropped
+   *         from the estimates
+   */
+  uint32_t GetTruncation (void) const;
+  /**
+   * Compute the batch means estimates over the steady state windows.
+   *
+   * \param throughput the throughput, in Mbit/s
+   * \param throughputHalfWidth the half-width of its confidence interval
+   * \param loss the packet loss rate, in percent
+   * \param lossHalfWidth the half-width of its confidence interval
+   * \return false if there are not enough windows yet
+   */
+  bool GetEstimates (double &throughput, double &throughputHalfWidth,
+                     double &loss, double &lossHalfWidth) const;
+
+
+private:
+  /// Number of batches of the batch means method
+  static const uint32_t BATCHES = 10;
+  /// Number of windows per group of MSER-5
+  static const uint32_t MSER_GROUP = 5;
+
+  /// Close the current window and check for convergence
+  void Sample (void);
+  /**
+   * \return the number of windows of the transient, according to MSER-5
+   */
+  uint32_t ComputeTruncation (void) const;
+
+  const ClientStatistics &m_statistics; //!< counters of the clients
+  uint32_t m_payloadSize;               //!< size of the packets
+  Time m_window;                        //!< duration of a window
+  double m_precision;                   //!< relative target for the throughput
+  double m_lossPrecision;               //!< target for the loss rate
+  Time m_start;                         //!< start of the first window
+  uint64_t m_lastSent;                  //!< packets sent at the end of the last window
+  uint64_t m_lastReceived;              //!< packets received at the end of the last window
+  std::vector<uint64_t> m_sent;         //!< packets sent in each window
+  std::vector<uint64_t> m_received;     //!< packets received in each window
+  uint32_t m_truncation;                //!< number of windows of the transient
+  bool m_steady;                        //!< whether the estimates converged
+};
+
+SteadyStateDetector::SteadyStateDetector (const ClientStatistics &statistics, uint32_t payloadSize,
+                                          Time window, double precision, double lossPrecision)
+  : m_statistics (statistics),
+    m_payloadSize (payloadSize),
+    m_window (window),
+    m_precision (precision),
+    m_lossPrecision (lossPrecision),
+    m_lastSent (0),
+    m_lastReceived (0),
+    m_truncation (0),
+    m_steady (false)
+{
+}
+
+void
+SteadyStateDetector::Start (Time start)
+{
+  m_start = start;
+  Simulator::Schedule (start + m_window - Simulator::Now (), &SteadyStateDetector::Sample, this);
+}
+
+bool
+SteadyStateDetector::IsSteady (void) const
+{
+  return m_steady;
+}
+
+Time
+SteadyStateDetector::GetSteadyStart (void) const
+{
+  return m_start + TimeStep (m_window.GetTimeStep () * m_truncation);
+}
+
+uint32_t
+SteadyStateDetector::GetN (void) const
+{
+  return m_sent.size ();
+}
+
+uint32_t
+SteadyStateDetector::GetTruncation (void) const
+{
+  return m_truncation;
+}
+
+uint32_t
+SteadyStateDetector::ComputeTruncation (void) const
+{
+  uint32_t nGroups = m_received.size () / MSER_GROUP;
+  std::vector<double> groups (nGroups, 0);
+  for (uint32_t i = 0; i < nGroups * MSER_GROUP; i++)
+    {
+      groups[i / MSER_GROUP] += m_received[i];
+    }
+  //walk back from the end, so that the sums of the groups after the
+  //truncation point are available in a single pass
+  double sum = 0;
+  double squares = 0;
+  uint32_t best = 0;
+  double bestMser = 0;
+  for (uint32_t d = nGroups; d-- > 0; )
+    {
+      sum += groups[d];
+      squares += groups[d] * groups[d];
+      double n = nGroups - d;
+      double mser = (squares - sum * sum / n) / (n * n);
+      if (d <= nGroups / 2 && (d == nGroups / 2 || mser <= bestMser))
+        {
+          best = d;
+          bestMser = mser;
+        }
+    }
+  return best * MSER_GROUP;
+}
+
+bool
+SteadyStateDetector::GetEstimates (double &throughput, double &throughputHalfWidth,
+                                   double &loss, double &lossHalfWidth) const
+{
+  uint32_t batchSize = (m_sent.size () - m_truncation) / BATCHES;
+  if (batchSize == 0)
+    {
+      return false;
+    }
+  //the windows which do not fill a batch are dropped from the transient side
+  uint32_t first = m_sent.size () - batchSize * BATCHES;
+  double throughputs[BATCHES];
+  double losses[BATCHES];
+  for (uint32_t b = 0; b < BATCHES; b++)
+    {
+      uint64_t sent = 0;
+      uint64_t received = 0;
+      for (uint32_t i = first + b * batchSize; i < first + (b + 1) * batchSize; i++)
+        {
+          sent += m_sent[i];
+          received += m_received[i];
+        }
+      throughputs[b] = received * m_payloadSize * 8 / (m_window.GetSeconds () * batchSize * 1000000.0);
+      losses[b] = sent > 0 ? 100.0 * (static_cast<double> (sent) - received) / sent : 0;
+    }
+  //0.975 quantile of the Student t distribution with BATCHES - 1 degrees of freedom
+  const double t = 2.262;
+  double *series[] = {throughputs, losses};
+  double *means[] = {&throughput, &loss};
+  double *halfWidths[] = {&throughputHalfWidth, &lossHalfWidth};
+  for (uint32_t s = 0; s < 2; s++)
+    {
+      double sum = 0;
+      for (uint32_t b = 0; b < BATCHES; b++)
+        {
+          sum += series[s][b];
+        }
+      double mean = sum / BATCHES;
+      double squares = 0;
+      for (uint32_t b = 0; b < BATCHES; b++)
+        {
+          squares += (series[s][b] - mean) * (series[s][b] - mean);
+        }
+      *means[s] = mean;
+      *halfWidths[s] = t * std::sqrt (squares / (BATCHES - 1) / BATCHES);
+    }
+  return true;
+}
+
+void
+SteadyStateDetector::Sample (void)
+{
+  uint64_t sent = m_statistics.GetSent ();
+  uint64_t received = m_statistics.GetReceived ();
+  m_sent.push_back (sent - m_lastSent);
+  m_received.push_back (received - m_lastReceived);
+  m_lastSent = sent;
+  m_lastReceived = received;
+
+  m_truncation = ComputeTruncation ();
+  double throughput;
+  double throughputHalfWidth;
+  double loss;
+  double lossHalfWidth;
+  //at least one MSER group per batch
+  if (m_sent.size () - m_truncation >= BATCHES * MSER_GROUP
+      && GetEstimates (throughput, throughputHalfWidth, loss, lossHalfWidth)
+      && throughput > 0
+      && throughputHalfWidth <= m_precision * throughput
+      && lossHalfWidth <= m_lossPrecision)
+    {
+      NS_LOG_INFO ("steady state from " << GetSteadyStart ().GetSeconds () << " s, converged at "
+                   << Simulator::Now ().GetSeconds () << " s");
+      m_steady = true;
+      Simulator::Stop ();
+      return;
+    }
+  Simulator::Schedule (m_window, &SteadyStateDetector::Sample, this);
+}
+
+/**
+ * Contention statistics of the DcfManager of each node: the counters
+ * which the DcfManagers keep, and the access grants, collisions and
+ * expected backoff delays of their trace sources, broken down by
+ * DcfState. The DcfStates of a MAC are its DcaTxop (0) followed by the
+ * EdcaTxopNs of AC_VO, AC_VI, AC_BE and AC_BK (1 to 4).
+ */
+class DcfContention
+{
+public:
+  /**
+   * Connect to the trace sources of the DcfManager of a node.
+   *
+   * \param name the name of the node in the report
+   * \param manager the DcfManager of the node
+   */
+  void Add (std::string name, DcfManager *manager);
+
+  /**
+   * Print the statistics of each node. The counters are read from the
+   * DcfManagers, so this must be called before the devices are disposed.
+   *
+   * \param os the output stream
+   */
+  void Print (std::ostream &os) const;
+
+
+private:
+  /// Trace counters of a DcfManager
+  struct Counters
+  {
+    std::string name;                 //!< name of the node
+    DcfManager *manager;              //!< the DcfManager, owned by the MAC
+    std::vector<uint64_t> grants;     //!< access grants, per DcfState
+    std::vector<uint64_t> collisions; //!< collisions, per DcfState
+    uint64_t backoffDelays;           //!< number of expected backoff delays
+    Time maxBackoffDelay;             //!< longest expected backoff delay
+  };
+
+  /**
+   * \param counters the counters of the DcfManager
+   * \param index the index of the DcfState
+   */
+  static void AccessGranted (Counters *counters, uint32_t index);
+  /**
+   * \param counters the counters of the DcfManager
+   * \param index the index of the DcfState
+   */
+  static void Collision (Counters *counters, uint32_t index);
+  /**
+   * \param counters the counters of the DcfManager
+   * \param delay the expected backoff delay
+   */
+  static void ExpectedBackoffDelay (Counters *counters, Time delay);
+
+  std::deque<Counters> m_counters; //!< does not move the counters when growing
+};
+
+void
+DcfContention::Add (std::string name, DcfManager *manager)
+{
+  m_counters.push_back (Counters ());
+  Counters &slot = m_counters.back ();
+  slot.name = name;
+  slot.manager = manager;
+  slot.backoffDelays = 0;
+  manager->TraceConnectWithoutContext ("AccessGranted", MakeBoundCallback (&DcfContention::AccessGranted, &slot));
+  manager->TraceConnectWithoutContext ("Collision", MakeBoundCallback (&DcfContention::Collision, &slot));
+  manager->TraceConnectWithoutContext ("ExpectedBackoffDelay", MakeBoundCallback (&DcfContention::ExpectedBackoffDelay, &slot));
+}
 
-//trace sink function for keeping track of packets recieved  
-void Recieve (std::string context, Ptr<const Packet> packet)
+void
+DcfContention::Print (std::ostream &os) const
 {
-	NS_LOG_UNCOND(context);
-	packetRec+=1; //total packets recieved 
-        if(context == "/NodeList/4/ApplicationList/0/$ns3::UdpEchoServer/Rx"){
-        	packetRec0++;
-        	//std::cout << "incrementing for c1" << "\n";
+  for (std::deque<Counters>::const_iterator i = m_counters.begin (); i != m_counters.end (); i++)
+    {
+      const DcfManager *manager = i->manager;
+      os << i->name << " dcf grants: " << manager->GetGrants () << "\n";
+      os << i->name << " dcf collisions: " << manager->GetCollisions () << "\n";
+      os << i->name << " dcf internal collisions: " << manager->GetInternalCollisions () << "\n";
+      if (i->backoffDelays > 0)
+        {
+          os << i->name << " dcf mean expected backoff delay: "
+             << manager->GetTotalBackoffDelay ().GetMicroSeconds () / static_cast<double> (i->backoffDelays) << " us\n";
+          os << i->name << " dcf max expected backoff delay: " << i->maxBackoffDelay.GetMicroSeconds () << " us\n";
         }
-	else if(context == "/NodeList/4/ApplicationList/1/$ns3::UdpEchoServer/Rx"){
- 		packetRec1++;
-		//std::cout << "incrementing for c2" << "\n";
+      for (uint32_t j = 0; j < std::max (i->grants.size (), i->collisions.size ()); j++)
+        {
+          os << i->name << " dcf state " << j << " grants: " << (j < i->grants.size () ? i->grants[j] : 0) << "\n";
+          os << i->name << " dcf state " << j << " collisions: " << (j < i->collisions.size () ? i->collisions[j] : 0) << "\n";
+        }
+    }
+  os << "\n";
+}
+
+void
+DcfContention::AccessGranted (Counters *counters, uint32_t index)
+{
+  if (index >= counters->grants.size ())
+    {
+      counters->grants.resize (index + 1, 0);
+    }
+  counters->grants[index]++;
+}
+
+void
+DcfContention::Collision (Counters *counters, uint32_t index)
+{
+  if (index >= counters->collisions.size ())
+    {
+      counters->collisions.resize (index + 1, 0);
+    }
+  counters->collisions[index]++;
+}
+
+void
+DcfContention::ExpectedBackoffDelay (Counters *counters, Time delay)
+{
+  counters->backoffDelays++;
+  counters->maxBackoffDelay = std::max (counters->maxBackoffDelay, delay);
+}
+
+/**
+ * Time series of the contention statistics of the DcfManager of each
+ * node. The DcfManagers sample themselves every SampleInterval through
+ * their StateStatistics and Deferrals trace sources, and each sample is
+ * written as CSV rows: one per DcfState to <prefix>-states.csv and one
+ * per node to <prefix>-deferrals.csv. The values are cumulative from
+ * the start of the run.
+ */
+class DcfSeries
+{
+public:
+  /**
+   * Create the CSV files.
+   *
+   * \param prefix the prefix of the names of the files
+   */
+  void Open (std::string prefix);
+  /**
+   * Start sampling the DcfManager of a node.
+   *
+   * \param name the name of the node in the files
+   * \param manager the DcfManager of the node
+   * \param interval the interval between two samples
+   */
+  void Add (std::string name, DcfManager *manager, Time interval);
+
+
+private:
+  /// A node whose DcfManager is sampled
+  struct Node
+  {
+    DcfSeries *series; //!< the series which writes the samples
+    std::string name;  //!< name of the node
+  };
+
+  /**
+   * \param node the node
+   * \param index the index of the DcfState
+   * \param stats the statistics of the DcfState
+   */
+  static void SampleState (Node *node, uint32_t index, const DcfManager::StateStatistics &stats);
+  /**
+   * \param node the node
+   * \param busy the time deferred to the PHY being busy
+   * \param eifs the time deferred to EIFS
+   * \param nav the time deferred to the NAV
+   * \param timeout the time deferred to ack and CTS timeouts
+   */
+  static void SampleDeferrals (Node *node, Time busy, Time eifs, Time nav, Time timeout);
+
+  std::deque<Node> m_nodes;  //!< does not move the nodes when growing
+  std::ofstream m_states;    //!< the CSV file of the DcfStates
+  std::ofstream m_deferrals; //!< the CSV file of the deferrals
+};
+
+void
+DcfSeries::Open (std::string prefix)
+{
+  std::string states = prefix + "-states.csv";
+  m_states.open (states.c_str ());
+  if (!m_states.is_open ())
+    {
+      NS_FATAL_ERROR ("cannot open " << states);
+    }
+  m_states << "time,node,state,grants,collisions,internal collisions\n";
+  std::string deferrals = prefix + "-deferrals.csv";
+  m_deferrals.open (deferrals.c_str ());
+  if (!m_deferrals.is_open ())
+    {
+      NS_FATAL_ERROR ("cannot open " << deferrals);
+    }
+  m_deferrals << "time,node,busy (us),eifs (us),nav (us),timeout (us)\n";
+}
+
+void
+DcfSeries::Add (std::string name, DcfManager *manager, Time interval)
+{
+  m_nodes.push_back (Node ());
+  Node &node = m_nodes.back ();
+  node.series = this;
+  node.name = name;
+  manager->TraceConnectWithoutContext ("StateStatistics", MakeBoundCallback (&DcfSeries::SampleState, &node));
+  manager->TraceConnectWithoutContext ("Deferrals", MakeBoundCallback (&DcfSeries::SampleDeferrals, &node));
+  manager->SetSampleInterval (interval);
+}
+
+void
+DcfSeries::SampleState (Node *node, uint32_t index, const DcfManager::StateStatistics &stats)
+{
+  node->series->m_states << Simulator::Now ().GetSeconds () << "," << node->name << "," << index
+                         << "," << stats.grants << "," << stats.collisions
+                         << "," << stats.internalCollisions << "\n";
+}
+
+void
+DcfSeries::SampleDeferrals (Node *node, Time busy, Time eifs, Time nav, Time timeout)
+{
+  node->series->m_deferrals << Simulator::Now ().GetSeconds () << "," << node->name
+                            << "," << busy.GetMicroSeconds () << "," << eifs.GetMicroSeconds ()
+                            << "," << nav.GetMicroSeconds () << "," << timeout.GetMicroSeconds () << "\n";
+}
+
+//capture the frames sent and received by the PHY of a wifi device
+static Ptr<AsyncPcapWriter>
+EnableAsyncPcap (std::string prefix, Ptr<NetDevice> device, uint32_t snapLen)
+{
+  Ptr<AsyncPcapWriter> writer = CreateObject<AsyncPcapWriter> ();
+  writer->Open (PcapHelper ().GetFilenameFromDevice (prefix, device), PcapHelper::DLT_IEEE802_11_RADIO, snapLen);
+  //the same frames and radiotap headers as the pcap helper of the PHY
+  Ptr<WifiPhy> phy = DynamicCast<WifiNetDevice> (device)->GetPhy ();
+  WifiPcapSniffer::Connect (phy, PcapHelper::DLT_IEEE802_11_RADIO, MakeCallback (&AsyncPcapWriter::Write, writer));
+  return writer;
+}
+
+//capture the frames sent and received by the PHY of a wifi device as
+//phy.EnablePcap does, truncated to snapLen bytes by the pcap file
+static void
+EnablePcap (std::string prefix, Ptr<NetDevice> device, uint32_t snapLen)
+{
+  PcapHelper pcapHelper;
+  Ptr<PcapFileWrapper> file = pcapHelper.CreateFile (pcapHelper.GetFilenameFromDevice (prefix, device), std::ios::out,
+                                                     PcapHelper::DLT_IEEE802_11_RADIO, snapLen);
+  void (PcapFileWrapper::*write) (Time, Ptr<const Packet>) = &PcapFileWrapper::Write;
+  WifiPcapSniffer::Connect (DynamicCast<WifiNetDevice> (device)->GetPhy (), PcapHelper::DLT_IEEE802_11_RADIO,
+                            MakeCallback (write, file));
+}
+
+//the DcfManager which the MAC of a wifi device created for itself
+static DcfManager *
+GetDcfManager (Ptr<NetDevice> device)
+{
+  DcfManager *manager = DcfManager::GetDcfManager (DynamicCast<WifiNetDevice> (device)->GetPhy ());
+  NS_ABORT_MSG_IF (manager == 0, "no DcfManager for device " << device);
+  return manager;
 }
-	else if(context == "/NodeList/4/ApplicationList/2/$ns3::UdpEchoServer/Rx") packetRec2++;
-	else if(context == "/NodeList/4/ApplicationList/3/$ns3::UdpEchoServer/Rx") packetRec3++;
-       //first number is decided by how many Servers there are running?
+
+//duration of a HT-mixed format PPDU of the given size on a 20 MHz channel
+//with long guard interval, bitsPerSymbol being the number of data bits per
+//4 us OFDM symbol of the MCS
+static Time
+GetHtMixedDuration (uint32_t bytes, uint32_t bitsPerSymbol)
+{
+  //L-STF, L-LTF, L-SIG, HT-SIG, HT-STF and one HT-LTF
+  uint32_t preamble = 36;
+  //16 service bits and 6 tail bits
+  uint32_t nSymbols = (16 + 8 * bytes + 6 + bitsPerSymbol - 1) / bitsPerSymbol;
+  return MicroSeconds (preamble + 4 * nSymbols);
+}
+
+//print the metrics of the clients which a simulation prints, as predicted
+//by the analytical model: each client gets the same share of the model
+//throughput, capped by its offered load
+static void
+PrintModelMetrics (std::ostream &os, uint32_t nClients, uint32_t payloadSize, Time interval,
+                   Time duration, double modelThroughput)
+{
+  uint64_t sent = static_cast<uint64_t> (duration.GetSeconds () / interval.GetSeconds ());
+  double offered = payloadSize * 8 / (interval.GetSeconds () * 1000000.0);
+  double throughput = std::min (offered, modelThroughput / nClients);
+  uint64_t received = std::min (sent, static_cast<uint64_t> (throughput * 1000000.0 * duration.GetSeconds () / (payloadSize * 8)));
+  int64_t lost = static_cast<int64_t> (sent) - static_cast<int64_t> (received);
+  double loss = sent > 0 ? 100.0 * lost / sent : 0;
+  for (uint32_t i = 0; i < nClients; i++)
+    {
+      os << "client " << i << " sent: " << sent << "\n";
+      os << "client " << i << " received: " << received << "\n";
+      os << "client " << i << " lost: " << lost << "\n";
+      os << "client " << i << " packet loss rate: " << loss << "%\n";
+      os << "client " << i << " throughput: " << throughput << " Mbit/s\n";
+    }
+  os << "total lost packets: " << lost * nClients << "\n";
+  os << "packet loss rate: " << loss << "%\n";
+  os << "Throughput: " << throughput * nClients << " Mbit/s (model)\n";
 }
 
 int main (int argc, char *argv[])
@@ -85,14 +1036,110 @@ int main (int argc, char *argv[])
   uint32_t maxAmpduSize = 0;
   bool enableRts = 1;
   std::string interval = "0.0039"; //make it easier to change interval quickly
+  bool hiddenNodes = true;
+  std::string mode = "simulate";
+  std::string recordDcf = "";
+  bool sharedMedium = false;
+  uint32_t nStations = 4;
+  uint32_t nSleepingStations = 0;
+  bool asyncPcap = false;
+  uint32_t snapLen = 65535;
+  std::string captureFrames = "mgt,ctl,data";
+  uint32_t dataSampling = 1;
+  bool steadyState = false;
+  std::string window = "100ms";
+  double precision = 0.02;
+  double lossPrecision = 1;
+  std::string seriesFile = "";
+  std::string seriesWindow = "100ms";
+  bool dcfStatistics = false;
+  uint32_t dcfTraceRing = 0;
+  std::string dcfSeries = "";
+  std::string validationTime = "1s";
+  double modelTolerance = 10;
 
   CommandLine cmd;
   cmd.AddValue ("nMpdus", "Number of aggregated MPDUs", nMpdus);
   cmd.AddValue ("payloadSize", "Payload size in bytes", payloadSize);
   cmd.AddValue ("enableRts", "Enable RTS/CTS", enableRts); // 1: RTS/CTS enabled; 0: RTS/CTS disabled
   cmd.AddValue ("simulationTime", "Simulation time in seconds", simulationTime);
+  cmd.AddValue ("hiddenNodes", "Limit the wireless range so that the stations are hidden from each other", hiddenNodes);
+  cmd.AddValue ("mode", "simulate; auto: without hidden nodes, report a simulated sample if the analytical model agrees with it; model: only the analytical estimate", mode);
+  cmd.AddValue ("validationTime", "Simulated time of the sample which validates the analytical estimate in auto mode", validationTime);
+  cmd.AddValue ("modelTolerance", "Relative error of the analytical estimate, in percent, above which auto mode falls back to the full simulation", modelTolerance);
+  cmd.AddValue ("recordDcf", "If not empty, record the calls into each DcfManager to <recordDcf>-<n>.dcfr for dcf-replay", recordDcf);
+  cmd.AddValue ("nStations", "Number of stations", nStations);
+  cmd.AddValue ("sharedMedium", "Share the medium state of all the DcfManagers when there are no hidden nodes (not with --recordDcf)", sharedMedium);
+  cmd.AddValue ("sleepingStations", "Number of stations without traffic which sleep from the start", nSleepingStations);
+  cmd.AddValue ("steadyState", "Drop the transient and stop once the steady state throughput and loss rate have converged, at the latest after --simulationTime", steadyState);
+  cmd.AddValue ("window", "Measurement window of the steady state detection", window);
+  cmd.AddValue ("precision", "Target confidence interval half-width of the steady state throughput, relative to it", precision);
+  cmd.AddValue ("lossPrecision", "Target confidence interval half-width of the steady state loss rate, in percent", lossPrecision);
+  cmd.AddValue ("asyncPcap", "Write the pcap files from a background thread, in the radiotap format of the PHY helper", asyncPcap);
+  cmd.AddValue ("snapLen", "Maximum number of bytes of a frame written to the pcap files", snapLen);
+  cmd.AddValue ("captureFrames", "Comma-separated frame types written to the pcap files (mgt, ctl, data), implies --asyncPcap", captureFrames);
+  cmd.AddValue ("dataSampling", "Write one data frame out of this many to the pcap files, implies --asyncPcap", dataSampling);
+  cmd.AddValue ("seriesFile", "If not empty, write the time series of each client to this CSV file", seriesFile);
+  cmd.AddValue ("seriesWindow", "Window of the time series", seriesWindow);
+  cmd.AddValue ("dcfStatistics", "Report the contention statistics of the DcfManager of each node", dcfStatistics);
+  cmd.AddValue ("dcfSeries", "If not empty, write the contention statistics of each DcfManager every --seriesWindow to <dcfSeries>-states.csv and <dcfSeries>-deferrals.csv", dcfSeries);
+  cmd.AddValue ("dcfTraceRing", "If not 0, keep this many records of the events of each DcfManager and dump them at the end to SimpleHtHiddenStations-dcf-trace-<node id>.bin for dcf-trace-decode", dcfTraceRing);
   cmd.Parse (argc, argv);
 
+  if (mode != "simulate" && mode != "auto" && mode != "model")
+    {
+      NS_FATAL_ERROR ("unknown mode " << mode);
+    }
+  if (Time (window) <= Seconds (0))
+    {
+      NS_FATAL_ERROR ("the steady state window must be positive");
+    }
+  if (Time (seriesWindow) <= Seconds (0))
+    {
+      NS_FATAL_ERROR ("the series window must be positive");
+    }
+  if (mode == "auto" && (Time (validationTime) <= Seconds (0) || modelTolerance < 0))
+    {
+      NS_FATAL_ERROR ("the validation time must be positive and the model tolerance not negative");
+    }
+  if (sharedMedium && !recordDcf.empty ())
+    {
+      //the recording of a member would miss the medium events of the feeder
+      NS_FATAL_ERROR ("--recordDcf cannot be used with --sharedMedium");
+    }
+  bool managementFrames = false;
+  bool controlFrames = false;
+  bool dataFrames = false;
+  std::istringstream types (captureFrames);
+  std::string type;
+  while (std::getline (types, type, ','))
+    {
+      if (type == "mgt")
+        {
+          managementFrames = true;
+        }
+      else if (type == "ctl")
+        {
+          controlFrames = true;
+        }
+      else if (type == "data")
+        {
+          dataFrames = true;
+        }
+      else
+        {
+          NS_FATAL_ERROR ("unknown frame type \"" << type << "\" in --captureFrames, expected mgt, ctl or data");
+        }
+    }
+  if (!managementFrames || !controlFrames || !dataFrames || dataSampling != 1)
+    {
+      asyncPcap = true;
+      Config::SetDefault ("ns3::AsyncPcapWriter::ManagementFrames", BooleanValue (managementFrames));
+      Config::SetDefault ("ns3::AsyncPcapWriter::ControlFrames", BooleanValue (controlFrames));
+      Config::SetDefault ("ns3::AsyncPcapWriter::DataFrames", BooleanValue (dataFrames));
+      Config::SetDefault ("ns3::AsyncPcapWriter::DataSampling", UintegerValue (dataSampling));
+    }
+
   if (!enableRts)
     {
       Config::SetDefault ("ns3::WifiRemoteStationManager::RtsCtsThreshold", StringValue ("999999"));
@@ -108,12 +1155,15 @@ int main (int argc, char *argv[])
   maxAmpduSize = nMpdus * (payloadSize + 200);
 
   // Set the maximum wireless range to 5 meters in order to reproduce a hidden nodes scenario, i.e. the distance between hidden stations is larger than 5 meters
-  Config::SetDefault ("ns3::RangePropagationLossModel::MaxRange", DoubleValue (5));
+  // Without hidden nodes the range covers the whole topology
+  Config::SetDefault ("ns3::RangePropagationLossModel::MaxRange", DoubleValue (hiddenNodes ? 5 : 100));
 
   NodeContainer wifiStaNodes;
-  wifiStaNodes.Create (4);  //Increase # of station nodes to 4
+  wifiStaNodes.Create (nStations);
   NodeContainer wifiApNode;
   wifiApNode.Create (1);
+  NodeContainer sleepingNodes;
+  sleepingNodes.Create (nSleepingStations);
 
   YansWifiChannelHelper channel = YansWifiChannelHelper::Default ();
   channel.AddPropagationLoss ("ns3::RangePropagationLossModel"); //wireless range limited to 5 meters!
@@ -135,6 +1185,8 @@ int main (int argc, char *argv[])
 
   NetDeviceContainer staDevices;
   staDevices = wifi.Install (phy, mac, wifiStaNodes);
+  NetDeviceContainer sleepingDevices;
+  sleepingDevices = wifi.Install (phy, mac, sleepingNodes);
 
   mac.SetType ("ns3::ApWifiMac",
                "Ssid", SsidValue (ssid),
@@ -145,25 +1197,110 @@ int main (int argc, char *argv[])
   NetDeviceContainer apDevice;
   apDevice = wifi.Install (phy, mac, wifiApNode);
 
+  //the DcfManagers are created by the MACs, without their attribute
+  //defaults: configure them directly. The stations come first, so that
+  //the PHY of the first station, which transmits less than the AP, feeds
+  //the medium group.
+  NetDeviceContainer devices (staDevices, apDevice);
+  devices.Add (sleepingDevices);
+  for (uint32_t i = 0; i < devices.GetN (); i++)
+    {
+      DcfManager *manager = GetDcfManager (devices.Get (i));
+      if (!recordDcf.empty ())
+        {
+          manager->SetRecordFilePrefix (recordDcf);
+        }
+      if (sharedMedium && !hiddenNodes)
+        {
+          manager->SetMediumGroup (1);
+        }
+      if (dcfTraceRing > 0)
+        {
+          manager->SetTraceRingSize (dcfTraceRing);
+        }
+    }
+
+  // Analytical saturation estimate of the cell, fed from the contention
+  // parameters of the BE queue and the timings of the AP MAC. Every
+  // station and the AP (which echoes the packets back) contend.
+  Ptr<WifiMac> apMac = DynamicCast<WifiNetDevice> (apDevice.Get (0))->GetMac ();
+  PointerValue beQueue;
+  apMac->GetAttribute ("BE_EdcaTxopN", beQueue);
+  Ptr<EdcaTxopN> be = beQueue.Get<EdcaTxopN> ();
+  DcfAnalyticalModel model;
+  model.SetSlot (apMac->GetSlot ());
+  model.SetSifs (apMac->GetSifs ());
+  model.SetEifsNoDifs (apMac->GetEifsNoDifs ());
+  model.SetCwMin (be->GetMinCw ());
+  model.SetCwMax (be->GetMaxCw ());
+  model.SetAifsn (be->GetAifsn ());
+  //UDP, IP, LLC/SNAP, QoS MAC header, FCS and, when aggregating, the
+  //MPDU delimiter and padding
+  uint32_t mpduSize = payloadSize + 8 + 20 + 8 + 26 + 4;
+  if (nMpdus > 1)
+    {
+      mpduSize = (mpduSize + 4 + 3) / 4 * 4;
+    }
+  //MCS7 (65 Mbit/s) for data, MCS0 (6.5 Mbit/s) for control
+  model.SetFrameDurations (GetHtMixedDuration (nMpdus * mpduSize, 260),
+                           GetHtMixedDuration (nMpdus > 1 ? 32 : 14, 26));
+  if (enableRts)
+    {
+      model.EnableRtsCts (GetHtMixedDuration (20, 26), GetHtMixedDuration (14, 26));
+    }
+  model.SetPayloadSize (nMpdus * payloadSize);
+  uint32_t nContenders = wifiStaNodes.GetN () + wifiApNode.GetN ();
+  DcfAnalyticalModel::Estimate estimate = model.Solve (nContenders);
+  //every station and the AP get the same share of the transmissions
+  double modelThroughput = estimate.throughput * wifiStaNodes.GetN () / nContenders / 1000000.0;
+  double offeredLoad = wifiStaNodes.GetN () * payloadSize * 8 / (Time (interval).GetSeconds () * 1000000.0);
+
+  std::cout << "model collision probability: " << estimate.collisionProbability << "\n";
+  std::cout << "model saturation throughput: " << modelThroughput << " Mbit/s"
+            << " (offered " << offeredLoad << " Mbit/s)\n";
+  if (mode == "model")
+    {
+      PrintModelMetrics (std::cout, nStations, payloadSize, Time (interval), Seconds (simulationTime), modelThroughput);
+      Simulator::Destroy ();
+      return 0;
+    }
+  //the estimate is only trusted once a sample of the simulation agrees
+  bool validate = mode == "auto" && !hiddenNodes && offeredLoad >= modelThroughput;
+
   // Setting mobility model
   MobilityHelper mobility;
   Ptr<ListPositionAllocator> positionAlloc = CreateObject<ListPositionAllocator> ();
 
-  // AP is between the two stations, each station being located at 5 meters from the AP.
-  // The distance between the two stations is thus equal to 10 meters.
-  // Since the wireless range is limited to 5 meters, the two stations are hidden from each other.
+  // AP is at the center of the stations, each station being located at 5 meters from the AP.
+  // With 4 stations, the distance between two stations is at least 7 meters.
+  // Since the wireless range is limited to 5 meters, the stations are hidden from each other.
   // (X,Y,Z)
   positionAlloc->Add (Vector (5.0, 5.0, 0.0));  //set position of AP 
-  positionAlloc->Add (Vector (5.0, 10.0, 0.0)); //set positions of MS
-  positionAlloc->Add (Vector (0.0, 5.0, 0.0));
-  positionAlloc->Add (Vector (5.0, 0.0, 0.0));
-  positionAlloc->Add (Vector (10.0, 5.0, 0.0));
+  for (uint32_t i = 0; i < nStations; i++)
+    {
+      //the first 4 stations are north, west, south and east of the AP
+      double angle = M_PI / 2 + 2 * M_PI * i / nStations;
+      positionAlloc->Add (Vector (5.0 + 5.0 * std::cos (angle), 5.0 + 5.0 * std::sin (angle), 0.0));
+    }
+  for (uint32_t i = 0; i < nSleepingStations; i++)
+    {
+      //within 1 meter of the AP, so that they hear every node
+      double angle = 2 * M_PI * i / nSleepingStations;
+      positionAlloc->Add (Vector (5.0 + std::cos (angle), 5.0 + std::sin (angle), 0.0));
+    }
   mobility.SetPositionAllocator (positionAlloc);
 
   mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
 
   mobility.Install (wifiApNode);
   mobility.Install (wifiStaNodes);
+  mobility.Install (sleepingNodes);
+
+  for (uint32_t i = 0; i < sleepingDevices.GetN (); i++)
+    {
+      Ptr<WifiPhy> sleepingPhy = DynamicCast<WifiNetDevice> (sleepingDevices.Get (i))->GetPhy ();
+      Simulator::Schedule (Seconds (0), &WifiPhy::SetSleepMode, sleepingPhy);
+    }
 
   // Internet stack
   InternetStackHelper stack;
@@ -178,124 +1315,198 @@ int main (int argc, char *argv[])
   Ipv4InterfaceContainer ApInterface;
   ApInterface = address.Assign (apDevice);
 
-  //Create 4 servers ports 9-12
-  UdpEchoServerHelper myServer (9);
-  UdpEchoServerHelper myServer1 (10);
-  UdpEchoServerHelper myServer2 (11);
-  UdpEchoServerHelper myServer3 (12);
-  
-  //Install 4 servers on AP node 
-  ApplicationContainer serverApp = myServer.Install (wifiApNode);
-  serverApp.Start (Seconds (0.0));
-  serverApp.Stop (Seconds (simulationTime + 2));
-   
-  ApplicationContainer serverApp1 = myServer1.Install (wifiApNode);
-  serverApp1.Start (Seconds (0.0));
-  serverApp1.Stop (Seconds (simulationTime + 2));
-   
-  ApplicationContainer serverApp2 = myServer2.Install (wifiApNode);
-  serverApp2.Start (Seconds (0.0));
-  serverApp2.Stop (Seconds (simulationTime + 2));
-  
-  ApplicationContainer serverApp3 = myServer3.Install (wifiApNode);
-  serverApp3.Start (Seconds (0.0));
-  serverApp3.Stop (Seconds (simulationTime + 2));
-  
+  //Install an echo server on the AP for each station, on ports 9, 10, ...
+  //and an echo client on each station
+  ClientStatistics statistics;
+  for (uint32_t i = 0; i < nStations; i++)
+    {
+      UdpEchoServerHelper myServer (9 + i);
+      ApplicationContainer serverApp = myServer.Install (wifiApNode);
+      serverApp.Start (Seconds (0.0));
+      serverApp.Stop (Seconds (simulationTime + 2));
 
-  //Install UDP clients on each of the MS nodes
-  //comment out MS as needed for different scenarios 
-  //MS 1
-  UdpEchoClientHelper myClient (ApInterface.GetAddress (0), 9);
-  myClient.SetAttribute ("MaxPackets", UintegerValue (4294967295u));
-  myClient.SetAttribute ("Interval", TimeValue (Time (interval))); //packets/s
-  myClient.SetAttribute ("PacketSize", UintegerValue (payloadSize));
-  ApplicationContainer clientApp0 = myClient.Install(wifiStaNodes.Get(0));
-  clientApp0.Start(Seconds(1));
-  clientApp0.Stop (Seconds (simulationTime+1));
- 
-  //MS 2  
-  UdpEchoClientHelper myClient1 (ApInterface.GetAddress (0), 10);
-  myClient1.SetAttribute ("MaxPackets", UintegerValue (4294967295u));
-  myClient1.SetAttribute ("Interval", TimeValue (Time (interval))); //packets/s
-  myClient1.SetAttribute ("PacketSize", UintegerValue (payloadSize));
-  ApplicationContainer clientApp1 = myClient1.Install(wifiStaNodes.Get(1));
-  clientApp0.Start(Seconds(1));
-  clientApp0.Stop (Seconds (simulationTime+1));
-  //MS 3  
-  UdpEchoClientHelper myClient2 (ApInterface.GetAddress (0), 11);
-  myClient2.SetAttribute ("MaxPackets", UintegerValue (4294967295u));
-  myClient2.SetAttribute ("Interval", TimeValue (Time (interval))); //packets/s
-  myClient2.SetAttribute ("PacketSize", UintegerValue (payloadSize));
-  ApplicationContainer clientApp2 = myClient2.Install(wifiStaNodes.Get(2));
-  clientApp0.Start(Seconds(1));
-  clientApp0.Stop (Seconds (simulationTime+1));
-  //MS 4 
-  UdpEchoClientHelper myClient3 (ApInterface.GetAddress (0), 12);
-  myClient3.SetAttribute ("MaxPackets", UintegerValue (4294967295u));
-  myClient3.SetAttribute ("Interval", TimeValue (Time (interval))); //packets/s
-  myClient3.SetAttribute ("PacketSize", UintegerValue (payloadSize));
-  ApplicationContainer clientApp3 = myClient3.Install(wifiStaNodes.Get(3));
-  clientApp0.Start(Seconds(1));
-  clientApp0.Stop (Seconds (simulationTime+1));
-
-
-
-  phy.EnablePcap ("SimpleHtHiddenStations_Ap", apDevice.Get (0));
-  phy.EnablePcap ("SimpleHtHiddenStations_Sta1", staDevices.Get (0));
-  phy.EnablePcap ("SimpleHtHiddenStations_Sta2", staDevices.Get (1));
+      UdpEchoClientHelper myClient (ApInterface.GetAddress (0), 9 + i);
+      myClient.SetAttribute ("MaxPackets", UintegerValue (4294967295u));
+      myClient.SetAttribute ("Interval", TimeValue (Time (interval))); //packets/s
+      myClient.SetAttribute ("PacketSize", UintegerValue (payloadSize));
+      ApplicationContainer clientApp = myClient.Install (wifiStaNodes.Get (i));
+      clientApp.Start (Seconds (1));
+      clientApp.Stop (Seconds (simulationTime + 1));
 
-  Simulator::Stop (Seconds (simulationTime + 1));
-  
-  //Call trace sink functions
-  Config::Connect("/NodeList/*/ApplicationList/*/$ns3::UdpEchoClient/Tx", MakeCallback(&Send));
-  Config::Connect("/NodeList/*/ApplicationList/*/$ns3::UdpEchoServer/Rx", MakeCallback(&Recieve));
+      statistics.Add (clientApp.Get (0), serverApp.Get (0), 9 + i);
+    }
 
-  Simulator::Run ();
+  std::vector<Ptr<AsyncPcapWriter> > writers;
+  if (asyncPcap)
+    {
+      writers.push_back (EnableAsyncPcap ("SimpleHtHiddenStations_Ap", apDevice.Get (0), snapLen));
+      writers.push_back (EnableAsyncPcap ("SimpleHtHiddenStations_Sta1", staDevices.Get (0), snapLen));
+      if (nStations > 1)
+        {
+          writers.push_back (EnableAsyncPcap ("SimpleHtHiddenStations_Sta2", staDevices.Get (1), snapLen));
+        }
+    }
+  else if (snapLen != 65535)
+    {
+      EnablePcap ("SimpleHtHiddenStations_Ap", apDevice.Get (0), snapLen);
+      EnablePcap ("SimpleHtHiddenStations_Sta1", staDevices.Get (0), snapLen);
+      if (nStations > 1)
+        {
+          EnablePcap ("SimpleHtHiddenStations_Sta2", staDevices.Get (1), snapLen);
+        }
+    }
+  else
+    {
+      phy.EnablePcap ("SimpleHtHiddenStations_Ap", apDevice.Get (0));
+      phy.EnablePcap ("SimpleHtHiddenStations_Sta1", staDevices.Get (0));
+      if (nStations > 1)
+        {
+          phy.EnablePcap ("SimpleHtHiddenStations_Sta2", staDevices.Get (1));
+        }
+    }
+
+  DcfContention contention;
+  if (dcfStatistics)
+    {
+      for (uint32_t i = 0; i < staDevices.GetN (); i++)
+        {
+          std::ostringstream name;
+          name << "sta" << i;
+          contention.Add (name.str (), GetDcfManager (staDevices.Get (i)));
+        }
+      contention.Add ("ap", GetDcfManager (apDevice.Get (0)));
+    }
+  DcfSeries dcfSamples;
+  if (!dcfSeries.empty ())
+    {
+      dcfSamples.Open (dcfSeries);
+      for (uint32_t i = 0; i < staDevices.GetN (); i++)
+        {
+          std::ostringstream name;
+          name << "sta" << i;
+          dcfSamples.Add (name.str (), GetDcfManager (staDevices.Get (i)), Time (seriesWindow));
+        }
+      dcfSamples.Add ("ap", GetDcfManager (apDevice.Get (0)), Time (seriesWindow));
+    }
+
+  //the clients start sending at 1 s
+  SteadyStateDetector detector (statistics, payloadSize, Time (window), precision, lossPrecision);
+  if (steadyState)
+    {
+      detector.Start (Seconds (1));
+    }
+  ClientSeries series (statistics, payloadSize, Time (seriesWindow));
+  if (!seriesFile.empty ())
+    {
+      series.Start (Seconds (1), seriesFile);
+    }
+
+  Simulator::Stop (Seconds (simulationTime + 1));
+  bool modelAccepted = false;
+  if (validate)
+    {
+      //the run stops at the end of the sample first, and resumes until the
+      //stop above if the model is rejected
+      Simulator::Stop (std::min (Seconds (1) + Time (validationTime), Seconds (simulationTime + 1)));
+      Simulator::Run ();
+      //unless the steady state detection already ended the run
+      if (!(steadyState && detector.IsSteady ()))
+        {
+          Time sampleTime = Simulator::Now () - Seconds (1);
+          double sampleThroughput = statistics.GetReceived () * payloadSize * 8 / (sampleTime.GetSeconds () * 1000000.0);
+          double error = sampleThroughput > 0 ? std::fabs (sampleThroughput - modelThroughput) / sampleThroughput * 100 : 100;
+          std::cout << "validation throughput: " << sampleThroughput << " Mbit/s"
+                    << " (" << sampleTime.GetSeconds () << " s)\n";
+          std::cout << "validation model error: " << error << "%\n";
+          modelAccepted = sampleThroughput > 0 && error <= modelTolerance;
+          if (!modelAccepted && Simulator::Now () < Seconds (simulationTime + 1))
+            {
+              std::cout << "model rejected, simulating\n";
+              Simulator::Run ();
+            }
+        }
+    }
+  else
+    {
+      Simulator::Run ();
+    }
+  for (uint32_t i = 0; i < writers.size (); i++)
+    {
+      writers[i]->Close ();
+    }
+  //before the MACs delete their DcfManagers
+  if (dcfStatistics)
+    {
+      contention.Print (std::cout);
+    }
+  if (dcfTraceRing > 0)
+    {
+      for (uint32_t i = 0; i < devices.GetN (); i++)
+        {
+          std::ostringstream filename;
+          filename << "SimpleHtHiddenStations-dcf-trace-" << devices.Get (i)->GetNode ()->GetId () << ".bin";
+          std::ofstream os (filename.str ().c_str (), std::ios::binary);
+          if (!os.is_open ())
+            {
+              NS_FATAL_ERROR ("cannot open " << filename.str ());
+            }
+          GetDcfManager (devices.Get (i))->WriteTraceRing (os);
+        }
+    }
+  //the validation sample is reported when the model was accepted
+  Time duration = (steadyState || modelAccepted) ? Simulator::Now () - Seconds (1) : Seconds (simulationTime);
   Simulator::Destroy ();
   
   
-  //calculate needed measurements
-  
-  lostPackets0 = packetSent0 - packetRec0;
-  lostPackets1 = packetSent1 - packetRec1;
-  lostPackets2 = packetSent2 - packetRec2;
-  lostPackets3 = packetSent3 - packetRec3;
-
-  throughput0 = packetRec0 * payloadSize * 8 / (simulationTime *  1000000.0 );
-  throughput1 = packetRec1 * payloadSize * 8 / (simulationTime *  1000000.0 );
-  throughput2 = packetRec2 * payloadSize * 8 / (simulationTime *  1000000.0 );
-  throughput3 = packetRec3 * payloadSize * 8 / (simulationTime *  1000000.0 );
-  
   //output needed measurements
+  statistics.Print (std::cout, payloadSize, duration);
+  statistics.PrintMetrics (std::cout, payloadSize, duration);
+  statistics.PrintDelays (std::cout);
 
-  std::cout << "Packets sent for client 0: " << packetSent0 << "\n";
-  std::cout << "Packets sent for client 1: " << packetSent1 << "\n";
-  std::cout << "Packets sent for client 2: " << packetSent2 << "\n";
-  std::cout << "Packets sent for client 3: " << packetSent3 << "\n\n";
-
-  std::cout << "Packets recv for client 0: " << packetRec0 << "\n";
-  std::cout << "Packets recv for client 1: " << packetRec1 << "\n";
-  std::cout << "Packets recv for client 2: " << packetRec2 << "\n";
-  std::cout << "Packets recv for client 3: " << packetRec3 << "\n\n";
-
-  std::cout << "lost packets for client 0: " << lostPackets0 << "\n";
-  std::cout << "lost packets for client 1: " << lostPackets1 << "\n";
-  std::cout << "lost packets for client 2: " << lostPackets2 << "\n";
-  std::cout << "lost packets for client 3: " << lostPackets3 << "\n\n";
-
-  std::cout << "throughput for client 0: " << throughput0 << "\n";
-  std::cout << "throughput for client 1: " << throughput1 << "\n";
-  std::cout << "throughput for client 2: " << throughput2 << "\n";
-  std::cout << "throughput for client 3: " << throughput3 << "\n\n";
-
-  int lostPackets = packetSent - packetRec;
+  uint64_t packetSent = statistics.GetSent ();
+  uint64_t packetRec = statistics.GetReceived ();
+  int64_t lostPackets = static_cast<int64_t> (packetSent) - static_cast<int64_t> (packetRec);
   std::cout << "total lost packets: " << lostPackets << "\n"; 
-  double percentage =(((double)packetSent -(double)packetRec) /(double)packetSent)*100;
-  std::cout << "packet loss rate: " << percentage << "%" << '\n';
+  double percentage = packetSent > 0 ? ((double)packetSent - (double)packetRec) / (double)packetSent * 100 : 0;
  //uint32_t totalPacketsThrough = DynamicCast<UdpServer> (serverApp.Get (0))->GetReceived ();
-  double throughput = packetRec * payloadSize * 8 / (simulationTime * 1000000.0);
+  double throughput = packetRec * payloadSize * 8 / (duration.GetSeconds () * 1000000.0);
+  double throughputHalfWidth;
+  double lossHalfWidth;
+  if (steadyState)
+    {
+      std::cout << "steady state: " << (detector.IsSteady () ? "converged" : "not converged") << "\n";
+      //without enough windows the whole run is reported
+      if (detector.GetEstimates (throughput, throughputHalfWidth, percentage, lossHalfWidth))
+        {
+          std::cout << "steady state start: " << detector.GetSteadyStart ().GetSeconds () << " s\n";
+          std::cout << "transient windows: " << detector.GetTruncation () << "\n";
+          std::cout << "steady state windows: " << detector.GetN () - detector.GetTruncation () << "\n";
+          std::cout << "simulated time: " << duration.GetSeconds () << " s\n";
+          std::cout << "throughput half-width: " << throughputHalfWidth << " Mbit/s\n";
+          std::cout << "packet loss rate half-width: " << lossHalfWidth << "%\n";
+        }
+    }
+  std::cout << "packet loss rate: " << percentage << "%" << '\n';
   std::cout << "Throughput: " << throughput << " Mbit/s" << '\n';
+  if (!hiddenNodes && offeredLoad >= modelThroughput && throughput > 0)
+    {
+      std::cout << "model error: " << std::fabs (throughput - modelThroughput) / throughput * 100 << "%" << '\n';
+    }
+  DelayHistogram oneWay = statistics.GetOneWayDelays ();
+  DelayHistogram roundTrip = statistics.GetRoundTripDelays ();
+  std::cout << "one-way delay p50: " << oneWay.GetQuantile (0.5).GetSeconds () * 1000 << " ms\n";
+  std::cout << "one-way delay p99: " << oneWay.GetQuantile (0.99).GetSeconds () * 1000 << " ms\n";
+  std::cout << "one-way delay p99.9: " << oneWay.GetQuantile (0.999).GetSeconds () * 1000 << " ms\n";
+  std::cout << "round-trip delay p50: " << roundTrip.GetQuantile (0.5).GetSeconds () * 1000 << " ms\n";
+  std::cout << "round-trip delay p99: " << roundTrip.GetQuantile (0.99).GetSeconds () * 1000 << " ms\n";
+  std::cout << "round-trip delay p99.9: " << roundTrip.GetQuantile (0.999).GetSeconds () * 1000 << " ms\n";
+  std::cout << "round-trip unmatched echoes: " << statistics.GetUnmatched () << "\n";
   std::cout << "interval: " << interval << "\n";
+  if (modelAccepted)
+    {
+      std::cout << "model accepted: 1\n";
+      std::cout << "model throughput: " << modelThroughput << " Mbit/s" << '\n';
+    }
 
   return 0;
 }
@@ -0,0 +1,244 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/abort.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/radiotap-header.h"
+#include "ns3/ampdu-subframe-header.h"
+#include "wifi-pcap-sniffer.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("WifiPcapSniffer");
+
+/// Data link type of 802.11 frames
+static const uint32_t DLT_IEEE802_11 = 105;
+/// Data link type of 802.11 frames with a radiotap header
+static const uint32_t DLT_IEEE802_11_RADIO = 127;
+
+void
+WifiPcapSniffer::Connect (Ptr<WifiPhy> phy, uint32_t dataLinkType, Sink sink)
+{
+  NS_LOG_FUNCTION (phy << dataLinkType);
+  NS_ABORT_MSG_IF (dataLinkType != DLT_IEEE802_11 && dataLinkType != DLT_IEEE802_11_RADIO,
+                   "unsupported data link type " << dataLinkType);
+  Ptr<Target> target = Create<Target> ();
+  target->sink = sink;
+  target->dataLinkType = dataLinkType;
+  phy->TraceConnectWithoutContext ("MonitorSnifferTx", MakeBoundCallback (&WifiPcapSniffer::SniffTx, target));
+  phy->TraceConnectWithoutContext ("MonitorSnifferRx", MakeBoundCallback (&WifiPcapSniffer::SniffRx, target));
+}
+
+void
+WifiPcapSniffer::SniffTx (Ptr<Target> target, Ptr<const Packet> packet, uint16_t channelFreqMhz,
+                          uint16_t channelNumber, uint32_t rate, WifiPreamble preamble,
+                          WifiTxVector txVector, struct mpduInfo aMpdu)
+{
+  target->sink (Simulator::Now (), GetRecord (target->dataLinkType, packet, channelFreqMhz, rate,
+                                              preamble, txVector, aMpdu, 0));
+}
+
+void
+WifiPcapSniffer::SniffRx (Ptr<Target> target, Ptr<const Packet> packet, uint16_t channelFreqMhz,
+                          uint16_t channelNumber, uint32_t rate, WifiPreamble preamble,
+                          WifiTxVector txVector, struct mpduInfo aMpdu,
+                          struct signalNoiseDbm signalNoise)
+{
+  target->sink (Simulator::Now (), GetRecord (target->dataLinkType, packet, channelFreqMhz, rate,
+                                              preamble, txVector, aMpdu, &signalNoise));
+}
+
+Ptr<const Packet>
+WifiPcapSniffer::GetRecord (uint32_t dataLinkType, Ptr<const Packet> packet,
+                            uint16_t channelFreqMhz, uint32_t rate,
+                            WifiPreamble preamble, WifiTxVector txVector,
+                            struct mpduInfo aMpdu,
+                            const struct signalNoiseDbm *signalNoise)
+{
+  if (dataLinkType == DLT_IEEE802_11)
+    {
+      return packet;
+    }
+
+  Ptr<Packet> p = packet->Copy ();
+  RadiotapHeader header;
+  uint8_t frameFlags = RadiotapHeader::FRAME_FLAG_NONE;
+  header.SetTsft (Simulator::Now ().GetMicroSeconds ());
+
+  //Our capture includes the FCS, so we set the flag to say so.
+  frameFlags |= RadiotapHeader::FRAME_FLAG_FCS_INCLUDED;
+
+  if (preamble == WIFI_PREAMBLE_SHORT)
+    {
+      frameFlags |= RadiotapHeader::FRAME_FLAG_SHORT_PREAMBLE;
+    }
+
+  if (txVector.IsShortGuardInterval ())
+    {
+      frameFlags |= RadiotapHeader::FRAME_FLAG_SHORT_GUARD;
+    }
+
+  header.SetFrameFlags (frameFlags);
+  header.SetRate (rate);
+
+  uint16_t channelFlags = 0;
+  switch (rate)
+    {
+    case 2:  //1Mbps
+    case 4:  //2Mbps
+    case 10: //5Mbps
+    case 22: //11Mbps
+      channelFlags |= RadiotapHeader::CHANNEL_FLAG_CCK;
+      break;
+
+    default:
+      channelFlags |= RadiotapHeader::CHANNEL_FLAG_OFDM;
+      break;
+    }
+
+  if (channelFreqMhz < 2500)
+    {
+      channelFlags |= RadiotapHeader::CHANNEL_FLAG_SPECTRUM_2GHZ;
+    }
+  else
+    {
+      channelFlags |= RadiotapHeader::CHANNEL_FLAG_SPECTRUM_5GHZ;
+    }
+
+  header.SetChannelFrequencyAndFlags (channelFreqMhz, channelFlags);
+
+  if (signalNoise != 0)
+    {
+      header.SetAntennaSignalPower (signalNoise->signal);
+      header.SetAntennaNoisePower (signalNoise->noise);
+    }
+
+  if (preamble == WIFI_PREAMBLE_HT_MF || preamble == WIFI_PREAMBLE_HT_GF || preamble == WIFI_PREAMBLE_NONE)
+    {
+      uint8_t mcsRate = 0;
+      uint8_t mcsKnown = RadiotapHeader::MCS_KNOWN_NONE;
+      uint8_t mcsFlags = RadiotapHeader::MCS_FLAGS_NONE;
+
+      mcsKnown |= RadiotapHeader::MCS_KNOWN_INDEX;
+      mcsRate = rate - 128;
+
+      mcsKnown |= RadiotapHeader::MCS_KNOWN_BANDWIDTH;
+      if (txVector.GetChannelWidth () == 40)
+        {
+          mcsFlags |= RadiotapHeader::MCS_FLAGS_BANDWIDTH_40;
+        }
+
+      mcsKnown |= RadiotapHeader::MCS_KNOWN_GUARD_INTERVAL;
+      if (txVector.IsShortGuardInterval ())
+        {
+          mcsFlags |= RadiotapHeader::MCS_FLAGS_GUARD_INTERVAL;
+        }
+
+      mcsKnown |= RadiotapHeader::MCS_KNOWN_HT_FORMAT;
+      if (preamble == WIFI_PREAMBLE_HT_GF)
+        {
+          mcsFlags |= RadiotapHeader::MCS_FLAGS_HT_GREENFIELD;
+        }
+
+      mcsKnown |= RadiotapHeader::MCS_KNOWN_NESS;
+      if (txVector.GetNess () & 0x01) //bit 1
+        {
+          mcsFlags |= RadiotapHeader::MCS_FLAGS_NESS_BIT_0;
+        }
+      if (txVector.GetNess () & 0x02) //bit 2
+        {
+          mcsKnown |= RadiotapHeader::MCS_KNOWN_NESS_BIT_1;
+        }
+
+      mcsKnown |= RadiotapHeader::MCS_KNOWN_FEC_TYPE; //only BCC is currently supported
+
+      mcsKnown |= RadiotapHeader::MCS_KNOWN_STBC;
+      if (txVector.IsStbc ())
+        {
+          mcsFlags |= RadiotapHeader::MCS_FLAGS_STBC_STREAMS;
+        }
+
+      header.SetMcsFields (mcsKnown, mcsFlags, mcsRate);
+    }
+
+  if (txVector.IsAggregation ())
+    {
+      uint16_t ampduStatusFlags = RadiotapHeader::A_MPDU_STATUS_NONE;
+      ampduStatusFlags |= RadiotapHeader::A_MPDU_STATUS_DELIMITER_CRC_KNOWN;
+      ampduStatusFlags |= RadiotapHeader::A_MPDU_STATUS_LAST_KNOWN;
+      //the MPDU delimiter and padding are not part of the captured frame
+      AmpduSubframeHeader hdr;
+      p->RemoveHeader (hdr);
+      p = p->CreateFragment (0, static_cast<uint32_t> (hdr.GetLength ()));
+      if (aMpdu.type == LAST_MPDU_IN_AGGREGATE || (hdr.GetEof () == true && hdr.GetLength () > 0))
+        {
+          ampduStatusFlags |= RadiotapHeader::A_MPDU_STATUS_LAST;
+        }
+      header.SetAmpduStatus (aMpdu.mpduRefNumber, ampduStatusFlags, hdr.GetCrc ());
+    }
+
+  if (preamble == WIFI_PREAMBLE_VHT)
+    {
+      uint16_t vhtKnown = RadiotapHeader::VHT_KNOWN_NONE;
+      uint8_t vhtFlags = RadiotapHeader::VHT_FLAGS_NONE;
+      uint8_t vhtBandwidth = 0;
+      uint8_t vhtMcsNss[4] = {0,0,0,0};
+      uint8_t vhtCoding = 0;
+      uint8_t vhtGroupId = 0;
+      uint16_t vhtPartialAid = 0;
+
+      vhtKnown |= RadiotapHeader::VHT_KNOWN_STBC;
+      if (txVector.IsStbc ())
+        {
+          vhtFlags |= RadiotapHeader::VHT_FLAGS_STBC;
+        }
+
+      vhtKnown |= RadiotapHeader::VHT_KNOWN_GUARD_INTERVAL;
+      if (txVector.IsShortGuardInterval ())
+        {
+          vhtFlags |= RadiotapHeader::VHT_FLAGS_GUARD_INTERVAL;
+        }
+
+      vhtKnown |= RadiotapHeader::VHT_KNOWN_BEAMFORMED; //Beamforming is currently not supported
+
+      vhtKnown |= RadiotapHeader::VHT_KNOWN_BANDWIDTH;
+      //not all bandwidth values are currently supported
+      if (txVector.GetChannelWidth () == 40)
+        {
+          vhtBandwidth = 1;
+        }
+      else if (txVector.GetChannelWidth () == 80)
+        {
+          vhtBandwidth = 4;
+        }
+      else if (txVector.GetChannelWidth () == 160)
+        {
+          vhtBandwidth = 11;
+        }
+
+      //only SU PPDUs are currently supported
+      vhtMcsNss[0] |= (txVector.GetNss () & 0x0f);
+      vhtMcsNss[0] |= (((rate - 128) << 4) & 0xf0);
+
+      header.SetVhtFields (vhtKnown, vhtFlags, vhtBandwidth, vhtMcsNss, vhtCoding, vhtGroupId, vhtPartialAid);
+    }
+
+  p->AddHeader (header);
+  return p;
+}
+
+} //namespace ns3
@@ -0,0 +1,117 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef WIFI_PCAP_SNIFFER_H
+#define WIFI_PCAP_SNIFFER_H
+
+#include "ns3/callback.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/ptr.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/wifi-phy.h"
+
+namespace ns3 {
+
+/**
+ * \brief pcap records of the frames sent and received by a wifi PHY
+ * \ingroup wifi
+ *
+ * Listens to the MonitorSnifferTx and MonitorSnifferRx trace sources of
+ * a WifiPhy, as WifiPhyHelper::EnablePcap does, and passes each frame to
+ * a sink in the format which the helper writes for the data link type:
+ * unchanged for DLT_IEEE802_11, and for DLT_IEEE802_11_RADIO without
+ * its A-MPDU subframe header and with a RadiotapHeader holding the
+ * timestamp, rate, channel, signal and noise, HT or VHT fields and
+ * A-MPDU status. Other pcap writers, such as AsyncPcapWriter or a pcap
+ * file created with a smaller snapLen, can then write the same captures
+ * as the helper.
+ */
+class WifiPcapSniffer
+{
+public:
+  /// Sink of the records, with the time of the frame and the record
+  typedef Callback<void, Time, Ptr<const Packet> > Sink;
+
+  /**
+   * \param phy the PHY whose frames are captured
+   * \param dataLinkType PcapHelper::DLT_IEEE802_11 or
+   *        PcapHelper::DLT_IEEE802_11_RADIO
+   * \param sink the sink of the records
+   */
+  static void Connect (Ptr<WifiPhy> phy, uint32_t dataLinkType, Sink sink);
+
+
+private:
+  /// Where the records of a PHY go
+  struct Target : public SimpleRefCount<Target>
+  {
+    Sink sink;             //!< the sink of the records
+    uint32_t dataLinkType; //!< the data link type of the records
+  };
+
+  /**
+   * \param target where the record goes
+   * \param packet the frame sent
+   * \param channelFreqMhz the frequency of the channel, in MHz
+   * \param channelNumber the number of the channel
+   * \param rate the rate, in units of 500 kbit/s, or 128 + the MCS
+   * \param preamble the preamble
+   * \param txVector the TXVECTOR of the frame
+   * \param aMpdu the A-MPDU information of the frame
+   */
+  static void SniffTx (Ptr<Target> target, Ptr<const Packet> packet, uint16_t channelFreqMhz,
+                       uint16_t channelNumber, uint32_t rate, WifiPreamble preamble,
+                       WifiTxVector txVector, struct mpduInfo aMpdu);
+  /**
+   * \param target where the record goes
+   * \param packet the frame received
+   * \param channelFreqMhz the frequency of the channel, in MHz
+   * \param channelNumber the number of the channel
+   * \param rate the rate, in units of 500 kbit/s, or 128 + the MCS
+   * \param preamble the preamble
+   * \param txVector the TXVECTOR of the frame
+   * \param aMpdu the A-MPDU information of the frame
+   * \param signalNoise the signal and noise power of the frame, in dBm
+   */
+  static void SniffRx (Ptr<Target> target, Ptr<const Packet> packet, uint16_t channelFreqMhz,
+                       uint16_t channelNumber, uint32_t rate, WifiPreamble preamble,
+                       WifiTxVector txVector, struct mpduInfo aMpdu,
+                       struct signalNoiseDbm signalNoise);
+  /**
+   * Build the record of a frame, as the pcap helper of the PHY does.
+   *
+   * \param dataLinkType the data link type of the record
+   * \param packet the frame
+   * \param channelFreqMhz the frequency of the channel, in MHz
+   * \param rate the rate, in units of 500 kbit/s, or 128 + the MCS
+   * \param preamble the preamble
+   * \param txVector the TXVECTOR of the frame
+   * \param aMpdu the A-MPDU information of the frame
+   * \param signalNoise the signal and noise power of a received frame,
+   *        0 for a frame sent
+   * \return the record
+   */
+  static Ptr<const Packet> GetRecord (uint32_t dataLinkType, Ptr<const Packet> packet,
+                                      uint16_t channelFreqMhz, uint32_t rate,
+                                      WifiPreamble preamble, WifiTxVector txVector,
+                                      struct mpduInfo aMpdu,
+                                      const struct signalNoiseDbm *signalNoise);
+};
+
+} //namespace ns3
+
+#endif /* WIFI_PCAP_SNIFFER_H */